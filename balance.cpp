@@ -0,0 +1,165 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>       /* abs() */
+#include <cstdint>     /* uint8_t */
+#include "balance.h"
+
+
+const std::string Alphabet("0123456789abcdefghijklmnopqrstuvwxyz");
+
+// ok. 20180127
+char CharMapping(std::string_view s) {
+  if (s.size() < 1) return '0';
+  size_t p = 0;
+  auto at   = [&s](size_t n) -> unsigned char { return n < s.size()? s[n] : 0; };
+  auto tail = [&s](size_t n) { return s.substr(std::min(n, s.size())); };
+
+  if (at(p) == '/') { if (s.size() < 2) return '0'; p++; }
+  if (at(p) == '%') { if (s.size() < 2) return '0'; p++; }
+
+  switch(at(p)) {
+     case 0x00: return '0';
+     case 0xC2: return CharMapping(tail(p+2));
+     case 0xC3:
+         switch(at(++p)) {
+            case 0xA0 ... 0xA6: return 'a';
+            case 0x80 ... 0x86: return 'a';
+            case 0xA7:          return 'c';
+            case 0x87:          return 'c';
+            case 0xA8 ... 0xAB: return 'e';
+            case 0x88 ... 0x8B: return 'e';
+            case 0xAC ... 0xAF: return 'i';
+            case 0x8C ... 0x8F: return 'i';
+            case 0xB0:          return 'd';
+            case 0x90:          return 'd';
+            case 0xB1:          return 'n';
+            case 0x91:          return 'n';
+            case 0xB2 ... 0xB6: return 'o';
+            case 0x92 ... 0x96: return 'o';
+            case 0xB7:          return CharMapping(tail(p+2));
+            case 0x97:          return CharMapping(tail(p+2));
+            case 0xB8:          return 'o';
+            case 0x98:          return 'o';
+            case 0xB9 ... 0xBC: return 'u';
+            case 0x99 ... 0x9C: return 'u';
+            case 0xBD:          return 'y';
+            case 0x9D:          return 'y';
+            case 0xBE:          return 't';
+            case 0x9E:          return 't';
+            case 0x9F:          return 's';
+            case 0xBF:          return 'y';
+            }
+     case 0xC4 ... 0xDF: return CharMapping(tail(p+2));
+     case 0xE0 ... 0xEF: return CharMapping(tail(p+3));
+     case 0xF0 ... 0xF4: return CharMapping(tail(p+4));
+     case '0' ... '9': return at(p);
+     case 'a' ... 'z': return at(p);
+     case 'A' ... 'Z': return at(p) + 32;
+     default: return CharMapping(tail(++p));
+     }
+  return '0'; /* never reached. */
+}
+
+/* A disk w/o letters is '-' in DiskSeq; its letters end at the next disk,
+ * which has letters. */
+std::vector<std::string> SequenceLetters(const std::string& DiskSeq) {
+  std::vector<std::string> result;
+  result.reserve(DiskSeq.size());
+
+  for(size_t i = 0; i < DiskSeq.size(); i++) {
+     size_t p1 = Alphabet.find(DiskSeq[i]);
+     if (p1 == std::string::npos) {
+        result.push_back("");
+        continue;
+        }
+     size_t p2 = Alphabet.size();
+     for(size_t n = i + 1; n < DiskSeq.size() and p2 == Alphabet.size(); n++)
+        p2 = std::min(p2, Alphabet.find(DiskSeq[n]));
+     result.push_back(p2 > p1? Alphabet.substr(p1, p2 - p1) : "");
+     }
+  return result;
+}
+
+std::string LettersSequence(const std::vector<std::string>& DiskChars) {
+  std::string result;
+  for(auto& s:DiskChars)
+     result.push_back(s.empty()? '-' : s[0]);
+  return result;
+}
+
+// ok. 20180127
+std::vector<std::string> SplitLetters(size_t Disks) {
+  std::vector<std::string> result;
+  if (!Disks) return result;
+  size_t d = (0.5 + Alphabet.size()) / Disks;
+
+  result.reserve(Disks);
+  for(size_t i = 0; i < Disks; i++)
+     result.push_back(Alphabet.substr(i * d, d));
+  return result;
+}
+
+std::vector<std::string> BalanceLetters(const std::vector<DiskLoad>& Disks, const size_t* UsePerChar) {
+  std::vector<std::string> result;
+  double Goal = 0;
+  size_t n = 0, lastOnline = 0;
+  for(size_t i = 0; i < Disks.size(); i++)
+     if (Disks[i].Online) {
+        Goal += Disks[i].Free;
+        n++;
+        lastOnline = i;
+        }
+  if (!n) return result;
+  Goal /= n;
+
+  std::string letters;
+  letters.reserve(Alphabet.size());
+  size_t last = std::string::npos;   /* position in Alphabet of the last assigned letter. */
+
+  for(size_t i = 0; i < Disks.size(); i++) {
+     const DiskLoad& d = Disks[i];
+     size_t first = (last == std::string::npos)? 0 : last + 1;
+     if (!d.Online) {
+        result.push_back("");
+        continue;
+        }
+     /* the last online disk takes all letters left, so that none gets lost. */
+     if (i == lastOnline) {
+        result.push_back(Alphabet.substr(std::min(first, Alphabet.size())));
+        last = Alphabet.size() - 1;
+        continue;
+        }
+     double left = d.Total - d.Striped;
+     for(size_t pos = first; pos < Alphabet.size(); pos++) {
+        double CharUse = UsePerChar[(uint8_t) Alphabet[pos]];
+
+        if (left < CharUse)
+           break;
+        if (left >= Goal or !letters.size()) {
+           letters += Alphabet[pos];
+           left -= CharUse;
+           last = pos;
+           }
+        else {
+           /* take one more letter, if that gets closer to Goal. */
+           if ((pos + 1) < Alphabet.size()) {
+              double NextUse = UsePerChar[(uint8_t) Alphabet[pos + 1]];
+              if (left > NextUse and std::abs(left - Goal - NextUse) < std::abs(left - Goal)) {
+                 letters += Alphabet[pos + 1];
+                 left -= NextUse;
+                 last = pos + 1;
+                 }
+              }
+           break;
+           }
+        }
+     result.push_back(letters);
+     letters.clear();
+     }
+  return result;
+}
@@ -0,0 +1,46 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+/*******************************************************************************
+ * The placement policy: which first letter of a recording goes to which disk.
+ * No file system access and no vdr dependencies, so that the very same code
+ * runs inside the plugin and in the offline simulator, see simulator.cpp.
+ ******************************************************************************/
+
+/* the first letters, in the order they are assigned to disks. */
+extern const std::string Alphabet;
+
+/* The letter of Alphabet for a recording, file or flat file name. */
+char CharMapping(std::string_view s);
+
+/* 'DiskSeq', the first letter of each disk or '-' for a disk w/o letters,
+ * as letters per disk. */
+std::vector<std::string> SequenceLetters(const std::string& DiskSeq);
+
+/* the reverse of SequenceLetters(). */
+std::string LettersSequence(const std::vector<std::string>& DiskChars);
+
+/* Alphabet split into Disks parts of equal length. */
+std::vector<std::string> SplitLetters(size_t Disks);
+
+/* The state of one disk for BalanceLetters(). */
+struct DiskLoad {
+  double Total;
+  double Free;
+  double Striped;   /* bytes used by striped recordings. */
+  bool Online;
+};
+
+/* Assigns letters to disks, so that the free space of all online disks is
+ * about equal; UsePerChar: bytes in use per letter, indexed by (uint8_t) char.
+ * One entry per disk; an offline disk gets an empty string, the last online
+ * disk all letters left. Empty if no disk is online.
+ */
+std::vector<std::string> BalanceLetters(const std::vector<DiskLoad>& Disks, const size_t* UsePerChar);
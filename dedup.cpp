@@ -0,0 +1,300 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>     /* memcpy(), memcmp() */
+#include <fcntl.h>     /* open(), posix_fadvise() */
+#include <unistd.h>    /* pread(), close() */
+#include "dedup.h"
+#include "fops.h"
+
+namespace Dedup {
+  static const uint64_t P1 = 11400714785092635457ULL;
+  static const uint64_t P2 = 14029467366897019727ULL;
+  static const uint64_t P3 =  1609587929392839161ULL;
+  static const uint64_t P4 =  9650029242287828579ULL;
+  static const uint64_t P5 =  2870177450012600261ULL;
+  static const size_t BlockSize = 1 << 20;
+  static const int Samples = 8;
+  static const size_t SampleSize = 1 << 16;
+
+  static inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+  static inline uint64_t Round(uint64_t acc, uint64_t in) { return Rotl(acc + in * P2, 31) * P1; }
+  static inline uint64_t Merge(uint64_t acc, uint64_t v) { return (acc ^ Round(0, v)) * P1 + P4; }
+  static inline uint64_t Read64(const char* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+  static inline uint32_t Read32(const char* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+  /* xxHash64 over data fed in pieces; every piece except the last one has
+   * to be a multiple of 32 bytes. */
+  class Hasher {
+  private:
+     uint64_t v[4];
+     uint64_t length;
+  public:
+     Hasher(uint64_t Seed = 0) : v{ Seed + P1 + P2, Seed + P2, Seed, Seed - P1 }, length(0) {}
+     void Stripes(const char* p, size_t n) {
+        /* the lanes don't depend on each other. */
+        for(const char* end = p + (n & ~(size_t) 31); p < end; p += 32) {
+           v[0] = Round(v[0], Read64(p));
+           v[1] = Round(v[1], Read64(p + 8));
+           v[2] = Round(v[2], Read64(p + 16));
+           v[3] = Round(v[3], Read64(p + 24));
+           }
+        }
+     void Add(const char* p, size_t n) {
+        Stripes(p, n);
+        length += n & ~(size_t) 31;
+        }
+     uint64_t Final(const char* p, size_t n) {
+        Stripes(p, n);
+        uint64_t total = length + n;
+        uint64_t h = total >= 32?
+           Rotl(v[0], 1) + Rotl(v[1], 7) + Rotl(v[2], 12) + Rotl(v[3], 18) : v[2] + P5;
+        if (total >= 32)
+           for(int i = 0; i < 4; i++)
+              h = Merge(h, v[i]);
+        h += total;
+        p += n & ~(size_t) 31;
+        n &= 31;
+        for(; n >= 8; p += 8, n -= 8)
+           h = Rotl(h ^ Round(0, Read64(p)), 27) * P1 + P4;
+        if (n >= 4) {
+           h = Rotl(h ^ (Read32(p) * P1), 23) * P2 + P3;
+           p += 4;
+           n -= 4;
+           }
+        for(; n; p++, n--)
+           h = Rotl(h ^ ((uint8_t) *p * P5), 11) * P1;
+        h ^= h >> 33; h *= P2;
+        h ^= h >> 29; h *= P3;
+        h ^= h >> 32;
+        return h;
+        }
+  };
+
+  /* reads up to n bytes at Offset. */
+  static bool ReadAt(int fd, char* Buffer, size_t n, uint64_t Offset, size_t& Got) {
+    Got = 0;
+    while(Got < n) {
+       ssize_t r = pread(fd, Buffer + Got, n - Got, Offset + Got);
+       if (r < 0) return false;
+       if (r == 0) break;
+       Got += r;
+       }
+    return true;
+  }
+}
+
+/* the reads below are no replays; see Prefetcher. */
+bool Dedup::FullHash(const std::string& Path, uint64_t& Hash) {
+  CopyingFile reading(Path);
+  int fd = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+     return false;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  std::vector<char> buf(BlockSize);
+  Hasher h;
+  uint64_t offset = 0;
+  size_t got;
+  bool ok;
+  while((ok = ReadAt(fd, buf.data(), buf.size(), offset, got)) and got == buf.size()) {
+     h.Add(buf.data(), got);
+     posix_fadvise(fd, offset, got, POSIX_FADV_DONTNEED);
+     offset += got;
+     }
+  close(fd);
+  if (ok)
+     Hash = h.Final(buf.data(), got);
+  return ok;
+}
+
+bool Dedup::SampleHash(const std::string& Path, uint64_t Size, uint64_t& Hash) {
+  CopyingFile reading(Path);
+  int fd = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+     return false;
+  std::vector<char> buf(SampleSize);
+  Hasher h(Size);
+  size_t got = 0;
+  bool ok = true;
+  uint64_t last = Size > SampleSize? Size - SampleSize : 0;
+  for(int i = 0; i < Samples and ok; i++) {
+     uint64_t offset = last / (Samples - 1) * i;
+     if (i == (Samples - 1))
+        offset = last;
+     ok = ReadAt(fd, buf.data(), buf.size(), offset, got) and got == std::min<uint64_t>(SampleSize, Size);
+     if (ok and i < (Samples - 1))
+        h.Add(buf.data(), got & ~(size_t) 31);
+     }
+  close(fd);
+  if (ok)
+     Hash = h.Final(buf.data(), got);
+  return ok;
+}
+
+bool Dedup::Equal(const std::string& a, const std::string& b) {
+  CopyingFile reading_a(a), reading_b(b);
+  std::ifstream fa(a.c_str(), std::ios::binary), fb(b.c_str(), std::ios::binary);
+  if (!fa or !fb)
+     return false;
+  std::vector<char> ba(BlockSize), bb(BlockSize);
+  while(true) {
+     fa.read(ba.data(), ba.size());
+     fb.read(bb.data(), bb.size());
+     if (fa.gcount() != fb.gcount() or memcmp(ba.data(), bb.data(), fa.gcount()))
+        return false;
+     if (fa.bad() or fb.bad())
+        return false;
+     if (fa.eof() or fb.eof())
+        return fa.eof() and fb.eof();
+     }
+}
+
+std::vector<Dedup::Set> Dedup::Find(const std::vector<DirSnapshot>& Disks, uint64_t MinSize,
+                                    std::function<bool(const std::string&)> Skip,
+                                    std::function<bool()> Cancelled) {
+  std::map<uint64_t, std::vector<std::string>> bySize;
+  for(auto& d:Disks)
+     for(size_t i = 0; i < d.Count(); i++)
+        if (d.IsFile(i) and d.Size(i) >= MinSize and EndsWith(d.CName(i), ".ts"))
+           bySize[d.Size(i)].push_back(d.Path(i));
+
+  /* splits each group by a hash and keeps the groups with two files or more. */
+  auto split = [&Cancelled](std::vector<std::vector<std::string>>& Groups,
+                            std::function<bool(const std::string&, uint64_t&)> Hash) {
+     std::vector<std::vector<std::string>> result;
+     for(auto& g:Groups) {
+        std::map<uint64_t, std::vector<std::string>> byHash;
+        for(auto& f:g) {
+           uint64_t h;
+           if (Cancelled())
+              return;
+           if (Hash(f, h))
+              byHash[h].push_back(f);
+           }
+        for(auto& b:byHash)
+           if (b.second.size() > 1)
+              result.push_back(std::move(b.second));
+        }
+     Groups.swap(result);
+     };
+
+  std::vector<Set> result;
+  for(auto& s:bySize) {
+     std::vector<std::vector<std::string>> groups(1);
+     for(auto& f:s.second)
+        if (!Skip(f))
+           groups[0].push_back(f);
+     if (groups[0].size() < 2)
+        continue;
+     uint64_t size = s.first;
+     split(groups, [size](const std::string& f, uint64_t& h) { return SampleHash(f, size, h); });
+     split(groups, [](const std::string& f, uint64_t& h) { return FullHash(f, h); });
+     if (Cancelled())
+        break;
+     for(auto& g:groups)
+        result.push_back({ size, std::move(g) });
+     }
+  return result;
+}
+
+
+/*******************************************************************************
+ * class SharedFiles
+ ******************************************************************************/
+void SharedFiles::Load(const std::string& FileName) {
+  std::lock_guard<std::mutex> lock(mutex);
+  filename = FileName;
+  std::ifstream is(FileName);
+  std::string line;
+  while(std::getline(is, line)) {
+     std::istringstream ls(line);
+     std::string path, link;
+     std::vector<std::string> links;
+     std::getline(ls, path, '\t');
+     while(std::getline(ls, link, '\t'))
+        links.push_back(link);
+     if (links.size() > 1)
+        files[path] = links;
+     }
+}
+
+/* Needs mutex locked. */
+bool SharedFiles::Save() {
+  if (filename.empty())
+     return false;
+  std::stringstream ss;
+  for(auto& f:files) {
+     ss << f.first;
+     for(auto& l:f.second)
+        ss << '\t' << l;
+     ss << '\n';
+     }
+  if (WriteFile(filename, ss.str()))
+     return true;
+  std::cerr << "cannot write " << filename << std::endl;
+  return false;
+}
+
+bool SharedFiles::Shared(std::string_view File) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return files.find(File) != files.end();
+}
+
+std::vector<std::string> SharedFiles::Links(std::string_view File) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = files.find(File);
+  return it == files.end()? std::vector<std::string>() : it->second;
+}
+
+void SharedFiles::Set(const std::string& File, const std::vector<std::string>& Links) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (Links.size() > 1)
+     files[File] = Links;
+  else
+     files.erase(File);
+  Save();
+}
+
+void SharedFiles::Moved(const std::string& From, const std::string& To) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = files.find(From);
+  if (it == files.end())
+     return;
+  files[To] = std::move(it->second);
+  files.erase(From);
+  Save();
+}
+
+void SharedFiles::Renamed(const std::string& File, const std::string& OldLink, const std::string& NewLink) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = files.find(File);
+  if (it == files.end())
+     return;
+  std::replace(it->second.begin(), it->second.end(), OldLink, NewLink);
+  Save();
+}
+
+bool SharedFiles::Release(const std::string& File, const std::string& Link) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = files.find(File);
+  if (it == files.end())
+     return true;
+  auto& links = it->second;
+  links.erase(std::remove(links.begin(), links.end(), Link), links.end());
+  bool last = links.empty();
+  if (links.size() <= 1)
+     files.erase(it);
+  Save();
+  return last;
+}
+
+size_t SharedFiles::Count() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return files.size();
+}
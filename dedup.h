@@ -0,0 +1,72 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include "dirwalk.h"
+
+/*******************************************************************************
+ * namespace Dedup
+ * Finds video files with equal contents on the disks, ie. a rerun recorded
+ * twice or a recording imported twice. Files are compared by size first, then
+ * by a hash of a few blocks spread over the file and only then by a hash of
+ * the whole file; most files are told apart without reading them.
+ ******************************************************************************/
+namespace Dedup {
+  struct Set {
+     uint64_t Size;                    /* of each file. */
+     std::vector<std::string> Files;   /* full paths on the disks. */
+     };
+
+  /* 64bit hash of a whole file, four independent lanes over 32 byte
+   * stripes (xxHash64); false on read errors. */
+  bool FullHash(const std::string& Path, uint64_t& Hash);
+
+  /* hash of Samples blocks at equal distances, incl. first and last one. */
+  bool SampleHash(const std::string& Path, uint64_t Size, uint64_t& Hash);
+
+  /* byte by byte. */
+  bool Equal(const std::string& a, const std::string& b);
+
+  /* '*.ts' files of at least MinSize in Disks, which are equal. Skip: files
+   * not to look at, ie. being written. Stops early, if Cancelled() is true.
+   */
+  std::vector<Set> Find(const std::vector<DirSnapshot>& Disks, uint64_t MinSize,
+                        std::function<bool(const std::string&)> Skip,
+                        std::function<bool()> Cancelled);
+}
+
+/*******************************************************************************
+ * class SharedFiles
+ * Video files referred to by more than one symlink, after Dedup, with their
+ * links; so that a shared file can be moved once, with all its links. Kept in
+ * a text file, one 'path<TAB>link<TAB>link..' per line.
+ ******************************************************************************/
+class SharedFiles {
+private:
+  std::mutex mutex;
+  std::map<std::string, std::vector<std::string>, std::less<>> files;
+  std::string filename;
+  bool Save();
+public:
+  void Load(const std::string& FileName);
+  bool Shared(std::string_view File);
+  /* the links to File, if shared; otherwise empty. */
+  std::vector<std::string> Links(std::string_view File);
+  /* File is now the target of Links. */
+  void Set(const std::string& File, const std::vector<std::string>& Links);
+  /* a shared file and all its links were moved from From to To. */
+  void Moved(const std::string& From, const std::string& To);
+  /* the link OldLink to File is now NewLink, ie. its recording was renamed. */
+  void Renamed(const std::string& File, const std::string& OldLink, const std::string& NewLink);
+  /* Link to File is removed; true, if it was the last one, ie. File may go. */
+  bool Release(const std::string& File, const std::string& Link);
+  size_t Count();
+};
@@ -0,0 +1,150 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>        /* strlen() */
+#include <fcntl.h>        /* open(), openat() */
+#include <unistd.h>       /* close(), syscall() */
+#include <sys/syscall.h>  /* SYS_getdents64 */
+#include <sys/stat.h>     /* statx(), fstatat() */
+#include "dirwalk.h"
+#include "fops.h"
+
+/* getdents64() has no glibc wrapper before 2.30. */
+struct linux_dirent64 {
+  uint64_t       d_ino;
+  int64_t        d_off;
+  unsigned short d_reclen;
+  unsigned char  d_type;
+  char           d_name[];
+};
+
+static const size_t BufferSize = 256 * 1024;
+
+
+DirSnapshot::DirSnapshot(std::string Root, bool Recursive, bool WithSizes) : root(Root) {
+  int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+     return;
+  std::vector<char> Buffer(BufferSize);
+  Scan(fd, npos, Recursive, WithSizes, Buffer);
+  close(fd);
+}
+
+void DirSnapshot::Scan(int fd, uint32_t Parent, bool Recursive, bool WithSizes, std::vector<char>& Buffer) {
+  size_t first = entries.size();
+
+  while(true) {
+     long n = syscall(SYS_getdents64, fd, Buffer.data(), Buffer.size());
+     if (n <= 0)
+        break;
+     for(long pos = 0; pos < n;) {
+        linux_dirent64* d = (linux_dirent64*) (Buffer.data() + pos);
+        pos += d->d_reclen;
+
+        const char* name = d->d_name;
+        if (name[0] == '.' and (!name[1] or (name[1] == '.' and !name[2])))
+           continue;
+
+        Entry e;
+        e.Name   = arena.size();
+        e.Parent = Parent;
+        e.Size   = 0;
+        e.Length = strlen(name);
+        e.Type   = d->d_type;
+
+        /* some file systems don't fill in d_type. */
+        if (e.Type == DT_UNKNOWN) {
+           struct stat st;
+           if (!fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW))
+              e.Type = IFTODT(st.st_mode);
+           }
+
+        if (WithSizes and e.Type == DT_REG) {
+#ifdef STATX_SIZE
+           struct statx stx;
+           if (!statx(fd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_SIZE, &stx))
+              e.Size = stx.stx_size;
+#else
+           struct stat st;
+           if (!fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW))
+              e.Size = st.st_size;
+#endif
+           }
+        arena.insert(arena.end(), name, name + e.Length + 1);
+        entries.push_back(e);
+        }
+     }
+
+  if (!Recursive)
+     return;
+
+  /* Buffer is free again; descend into the subdirs found. */
+  size_t last = entries.size();
+  for(size_t i = first; i < last; i++) {
+     if (entries[i].Type != DT_DIR)
+        continue;
+     int sub = openat(fd, CName(i), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+     if (sub < 0)
+        continue;
+     Scan(sub, i, Recursive, WithSizes, Buffer);
+     close(sub);
+     }
+}
+
+std::string DirSnapshot::Path(size_t i) const {
+  std::vector<uint32_t> chain;
+  for(uint32_t n = i; n != npos; n = entries[n].Parent)
+     chain.push_back(n);
+
+  std::string s(root);
+  for(auto it = chain.rbegin(); it != chain.rend(); ++it)
+     s.append(1, '/').append(CName(*it), entries[*it].Length);
+  return s;
+}
+
+
+std::vector<DirSnapshot> ScanDirs(const std::vector<std::string>& Roots, bool Recursive, bool WithSizes) {
+  std::vector<DirSnapshot> result(Roots.size(), DirSnapshot(""));
+  std::atomic<size_t> next(0);
+  size_t n = std::min<size_t>(Roots.size(), std::max(1U, std::thread::hardware_concurrency()));
+  std::vector<std::thread> Threads;
+
+  for(size_t t = 0; t < n; t++)
+     Threads.emplace_back([&]() {
+        for(size_t i = next++; i < Roots.size(); i = next++)
+           result[i] = DirSnapshot(Roots[i], Recursive, WithSizes);
+        });
+  for(auto& t:Threads)
+     t.join();
+  return result;
+}
+
+
+/* The top level dirs of Dir are scanned in parallel; usually one per series. */
+void FindSymlinks(std::string Dir, std::string Target, PathStore& Store, std::vector<PathStore::Handle>& Links) {
+  DirSnapshot top(Dir);
+  std::vector<std::string> Roots;
+  char buf[PATH_MAX];
+  Target += '/';
+
+  for(size_t i = 0; i < top.Count(); i++) {
+     if (top.IsDirectory(i))
+        Roots.push_back(top.Path(i));
+     else if (top.IsSymlink(i) and LinkDest(top.Path(i), buf, sizeof(buf)).find(Target) == 0)
+        Links.push_back(Store.Intern(top.Path(i)));
+     }
+
+  for(auto& s:ScanDirs(Roots, true))
+     for(size_t i = 0; i < s.Count(); i++)
+        if (s.IsSymlink(i)) {
+           std::string link(s.Path(i));
+           if (LinkDest(link, buf, sizeof(buf)).find(Target) == 0)
+              Links.push_back(Store.Intern(link));
+           }
+}
@@ -0,0 +1,52 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <dirent.h>    /* DT_DIR, DT_REG, DT_LNK */
+#include "pathstore.h"
+
+/*******************************************************************************
+ * class DirSnapshot
+ * The contents of a directory, optionally incl. all subdirs, read at once by
+ * getdents64() with a large buffer. The file type is taken from d_type, file
+ * sizes are only read if asked for, by statx() with STATX_SIZE only.
+ * All names are stored in one arena; an entry refers to its parent by index.
+ ******************************************************************************/
+class DirSnapshot {
+public:
+  struct Entry {
+     uint32_t Name;    /* offset into arena, null terminated. */
+     uint32_t Parent;  /* index of parent entry, or npos for entries of Root. */
+     uint64_t Size;    /* only if scanned WithSizes. */
+     uint16_t Length;
+     uint8_t  Type;    /* DT_xxx */
+     };
+  static const uint32_t npos = 0xFFFFFFFF;
+private:
+  std::string root;
+  std::vector<char> arena;
+  std::vector<Entry> entries;
+  void Scan(int fd, uint32_t Parent, bool Recursive, bool WithSizes, std::vector<char>& Buffer);
+public:
+  DirSnapshot(std::string Root, bool Recursive = false, bool WithSizes = false);
+  const std::string& Root() const            { return root; }
+  size_t Count() const                       { return entries.size(); }
+  const Entry& operator[](size_t i) const    { return entries[i]; }
+  const char* CName(size_t i) const          { return arena.data() + entries[i].Name; }
+  std::string Name(size_t i) const           { return std::string(CName(i), entries[i].Length); }
+  std::string Path(size_t i) const;
+  bool IsDirectory(size_t i) const           { return entries[i].Type == DT_DIR; }
+  bool IsSymlink(size_t i) const             { return entries[i].Type == DT_LNK; }
+  bool IsFile(size_t i) const                { return entries[i].Type == DT_REG; }
+  uint64_t Size(size_t i) const              { return entries[i].Size; }
+};
+
+/* Scans several directories in parallel, ie. one disk per thread. */
+std::vector<DirSnapshot> ScanDirs(const std::vector<std::string>& Roots, bool Recursive = false, bool WithSizes = false);
+
+/* Collects all symlinks below Dir, pointing to a file below Target. */
+void FindSymlinks(std::string Dir, std::string Target, PathStore& Store, std::vector<PathStore::Handle>& Links);
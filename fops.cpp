@@ -9,44 +9,52 @@
 #include <algorithm>
 #include <cstring>     /* memset() */
 #include <cstdio>      /* remove() */
+#include <ctime>       /* time() */
 #include <sys/types.h> /* stat() */
 #include <sys/stat.h>  /* stat() */
+#include <sys/sysmacros.h> /* major(), minor() */
+#include <cstdlib>     /* realpath(), free() */
 #include <unistd.h>    /* stat() */
+#include <fcntl.h>     /* open() */
 #include <dirent.h>    /* opendir() */
+#include <chrono>
+#include <mutex>
 #include <repfunc.h>
 #include "fops.h"
+#include "metrics.h"
+#include "health.h"
 
 
-bool IsDirectory(std::string Name) {
+bool IsDirectory(std::string_view Name) {
   struct stat st;
-  if (stat(Name.c_str(), &st))
+  if (stat(PathBuf(Name).c_str(), &st))
      return false;
   return S_ISDIR(st.st_mode) == 1;
 }
 
 // 20240901: OK
-bool IsSymlink(std::string Name) {
+bool IsSymlink(std::string_view Name) {
   struct stat st;
-  if (lstat(Name.c_str(), &st))
+  if (lstat(PathBuf(Name).c_str(), &st))
      return false;
   return S_ISLNK(st.st_mode) == 1;
 }
 
 // 20240901: OK
-bool IsFile(std::string Name) {
+bool IsFile(std::string_view Name) {
   struct stat st;
-  if (lstat(Name.c_str(), &st))
+  if (lstat(PathBuf(Name).c_str(), &st))
      return false;
   return S_ISREG(st.st_mode) == 1;
 }
 
-bool EndsWith(std::string Name, std::string s) {
+bool EndsWith(std::string_view Name, std::string_view s) {
   if (Name.size() < s.size()) return false;
   return std::equal(s.rbegin(), s.rend(), Name.rbegin());
 }
 
 // ok. 20180128
-bool IsVideoFile(std::string Name) {
+bool IsVideoFile(std::string_view Name) {
   if (EndsWith(Name, ".ts"))
      return true;
   else if (EndsWith(Name, ".vdr")) {
@@ -60,16 +68,22 @@ bool IsVideoFile(std::string Name) {
   return false;
 }
 
-std::string LinkDest(std::string Name) {
-  static char linkdest[1024];
+std::string LinkDest(std::string_view Name) {
+  char linkdest[1024];
+  return std::string(LinkDest(Name, linkdest, sizeof(linkdest)));
+}
+
+/* as above, but w/o allocation: the result is stored in Buffer. */
+std::string_view LinkDest(std::string_view Name, char* Buffer, size_t Size) {
   /* readlink() does not append a terminating null byte to buf.
    * It will (silently) truncate the contents (to a length of
    * bufsiz characters), in case the buffer is too small to
    * hold all of the contents.
    */
-  memset(linkdest, 0, sizeof(linkdest));
-  if (readlink(Name.c_str(), linkdest, 1024 - 1) < 0) *linkdest = 0;
-  return linkdest;
+  ssize_t n = readlink(PathBuf(Name).c_str(), Buffer, Size - 1);
+  if (n < 0) n = 0;
+  Buffer[n] = 0;
+  return std::string_view(Buffer, n);
 }
 
 
@@ -84,7 +98,7 @@ void ReplaceAll(std::string& s, std::string from, std::string to) {
 }*/
 
 // ok. 20180128
-std::string FlatPath(std::string Path) {
+std::string FlatPath(std::string_view Path) {
   std::string s(Path);
   size_t p = s.rfind(".rec/");
 
@@ -116,16 +130,16 @@ std::string FlatPath(std::string Path) {
   return s;
 }
 
-size_t FileSize(std::string Name) {
+size_t FileSize(std::string_view Name) {
   struct stat st;
-  if (stat(Name.c_str(), &st))
+  if (stat(PathBuf(Name).c_str(), &st))
      return false;
   return st.st_size;
 }
 
 // ok. 20180128
-bool MakeDirectory(std::string Name, bool Parents, bool DryRun) {
-  if (DirectoryExists(Name))
+bool MakeDirectory(std::string_view Name, bool Parents, bool DryRun) {
+  if (DirectoryExists(std::string(Name)))
      return true;
 
   if (!Parents) {
@@ -134,12 +148,12 @@ bool MakeDirectory(std::string Name, bool Parents, bool DryRun) {
         return true;
         }
      else
-        return mkdir(Name.c_str(),755) == 0;
+        return mkdir(PathBuf(Name).c_str(),755) == 0;
      }
 
   std::string fullpath;
 
-  for(auto dir:SplitStr(Name.substr(1), '/')) {
+  for(auto dir:SplitStr(std::string(Name.substr(1)), '/')) {
      fullpath += '/' + dir;
      if (!MakeDirectory(fullpath, false, DryRun))
         return false;
@@ -147,44 +161,283 @@ bool MakeDirectory(std::string Name, bool Parents, bool DryRun) {
   return true;
 }
 
-bool SymLink(std::string LinkName, std::string LinkDest, bool DryRun) {
+bool SymLink(std::string_view LinkName, std::string_view LinkDest, bool DryRun) {
   if (DryRun) {
      std::cerr << __FUNCTION__ << ": " << LinkName << " -> " << LinkDest << std::endl;
      return true;
      }
   else
-     return symlink(LinkDest.c_str(), LinkName.c_str()) == 0;
+     return symlink(PathBuf(LinkDest).c_str(), PathBuf(LinkName).c_str()) == 0;
+}
+
+/* Replaces an existing symlink without a window, where LinkName is missing:
+ * the new link is created under a temporary name and renamed over the old one.
+ */
+bool ReplaceSymLink(std::string_view LinkName, std::string_view LinkDest) {
+  std::string tmp(std::string(LinkName) + ".vdirs~");
+  ::Remove(tmp);
+  if (!SymLink(tmp, LinkDest))
+     return false;
+  if (!Rename(tmp, LinkName)) {
+     ::Remove(tmp);
+     return false;
+     }
+  return true;
 }
 
-void CopyFile(std::string From, std::string To, bool DryRun) {
+/* files currently read or written by CopyFile(). */
+static std::mutex CopyMutex;
+static std::multiset<std::string, std::less<>> Copying;
+
+bool IsCopying(std::string_view Name) {
+  std::lock_guard<std::mutex> lock(CopyMutex);
+  return Copying.find(Name) != Copying.end();
+}
+
+CopyingFile::CopyingFile(std::string_view Name) : name(Name) {
+  std::lock_guard<std::mutex> lock(CopyMutex);
+  Copying.emplace(name);
+}
+
+CopyingFile::~CopyingFile() {
+  std::lock_guard<std::mutex> lock(CopyMutex);
+  Copying.erase(Copying.find(name));
+}
+
+void CopyFile(std::string_view From, std::string_view To, bool DryRun) {
   if (DryRun)
      std::cerr << __FUNCTION__ << "(" << From << "," << To << ")" << std::endl;
   else {
-     std::ifstream src(From.c_str(), std::ios::binary);
-     std::ofstream dst(To.c_str()  , std::ios::binary);
-     dst << src.rdbuf();
+     CopyingFile f(From), t(To);
+     auto start = std::chrono::steady_clock::now();
+     std::ifstream src(PathBuf(From).c_str(), std::ios::binary);
+     std::ofstream dst(PathBuf(To).c_str()  , std::ios::binary);
+     /* read and write separately, so that an error is charged to its disk;
+      * 'dst << src.rdbuf()' reports a read error as failbit of dst. */
+     std::vector<char> buf(0x100000);
+     std::streamsize bytes = 0;
+     bool srcok = src.is_open(), dstok = dst.is_open();
+     while(srcok and dstok) {
+        src.read(buf.data(), buf.size());
+        srcok = !src.bad();
+        if (src.gcount() > 0 and !dst.write(buf.data(), src.gcount()))
+           dstok = false;
+        else
+           bytes += src.gcount();
+        if (src.eof())
+           break;
+        }
+     dst.close();
+     dstok = dstok and !dst.fail();
+     uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start).count();
+     Metrics::Add(Metrics::FilesCopied);
+     if (bytes > 0)
+        Metrics::Add(Metrics::BytesCopied, bytes);
+     Metrics::Add(Metrics::CopyNanos, nanos);
+     /* the latency of a copy is its time per MB, as files differ in size. */
+     uint64_t mb = bytes > 0? std::max<uint64_t>(1, bytes / 0x100000) : 1;
+     Health::Record(From, nanos / mb, srcok);
+     Health::Record(To, nanos / mb, dstok);
      }
 }
 
-void MoveFile(std::string From, std::string To, bool DryRun) {
+void MoveFile(std::string_view From, std::string_view To, bool DryRun) {
   if (DryRun)
      std::cerr << __FUNCTION__ << "(" << From << "," << To << ")" << std::endl;
   else {
      CopyFile(From, To);
-     if (FileSize(To) == FileSize(From))
+     /* the source goes only, once the copy is safe on the disk. */
+     std::string dir(To.substr(0, To.rfind('/')));
+     if (FileSize(To) == FileSize(From) and SyncFile(To) and SyncDirectory(dir))
         ::Remove(From);
      }
 }
 
-bool Remove(std::string Filename, bool DryRun) {
+bool Remove(std::string_view Filename, bool DryRun) {
   if (DryRun){
      std::cerr << __FUNCTION__ << "(" << Filename << ")" << std::endl;
      return true;
      }
   else
-     return remove(Filename.c_str()) == 0;
+     return remove(PathBuf(Filename).c_str()) == 0;
+}
+
+bool Rename(std::string_view From, std::string_view To) {
+  return rename(PathBuf(From).c_str(), PathBuf(To).c_str()) == 0;
+}
+
+/* Appends Text to File and returns, once it is on the disk. */
+bool WriteSync(int File, std::string_view Text) {
+  while(!Text.empty()) {
+     ssize_t n = write(File, Text.data(), Text.size());
+     if (n <= 0)
+        return false;
+     Text.remove_prefix(n);
+     }
+  return fdatasync(File) == 0;
+}
+
+/* Writes Text to FileName; readers see either the old or the new file, also
+ * after a power loss. */
+bool WriteFile(const std::string& FileName, const std::string& Text) {
+  std::string tmp(FileName + ".vdirs~");
+  int f = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (f < 0)
+     return false;
+  bool ok = WriteSync(f, Text);
+  close(f);
+  if (!ok or rename(tmp.c_str(), FileName.c_str())) {
+     remove(tmp.c_str());
+     return false;
+     }
+  return true;
+}
+
+/* Waits until the contents of the file Name are on the disk. */
+bool SyncFile(std::string_view Name) {
+  int f = open(PathBuf(Name).c_str(), O_RDONLY | O_CLOEXEC);
+  if (f < 0)
+     return false;
+  bool ok = fsync(f) == 0;
+  close(f);
+  return ok;
+}
+
+/* Makes a new, renamed or removed entry of the directory Name durable. */
+bool SyncDirectory(std::string_view Name) {
+  int f = open(PathBuf(Name).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (f < 0)
+     return false;
+  bool ok = fsync(f) == 0;
+  close(f);
+  return ok;
+}
+
+/* Moves the video file From, which is referenced by the symlink LinkName, to
+ * To and retargets the link. The source is removed only after the copy is
+ * complete and the link points to the new location.
+ */
+bool RelinkFile(std::string_view LinkName, std::string_view From, std::string_view To) {
+  return RelinkFile(std::vector<std::string>{ std::string(LinkName) }, From, To);
+}
+
+/* As above, for a file shared by several links; it is copied once. If one
+ * of the links can't be replaced, the others are set back to From.
+ * The copy and the new links are synced before From is removed, so that a
+ * power loss leaves either the old or the new file referenced.
+ */
+bool RelinkFile(const std::vector<std::string>& LinkNames, std::string_view From, std::string_view To) {
+  CopyFile(From, To);
+  std::string_view dir(To.substr(0, To.rfind('/')));
+  if (FileSize(To) != FileSize(From) or !SyncFile(To) or !SyncDirectory(dir)) {
+     ::Remove(To);
+     return false;
+     }
+  std::set<std::string> linkdirs;
+  for(size_t i = 0; i < LinkNames.size(); i++) {
+     if (!ReplaceSymLink(LinkNames[i], To)) {
+        while(i--)
+           ReplaceSymLink(LinkNames[i], From);
+        ::Remove(To);
+        return false;
+        }
+     linkdirs.insert(LinkNames[i].substr(0, LinkNames[i].rfind('/')));
+     }
+  for(auto& d:linkdirs)
+     SyncDirectory(d);
+  return ::Remove(From);
+}
+
+/* seconds since last modification, or 0 on error. */
+time_t FileAge(std::string_view Name) {
+  struct stat st;
+  if (stat(PathBuf(Name).c_str(), &st))
+     return 0;
+  return time(nullptr) - st.st_mtime;
+}
+
+/* Returns all mount points from /proc/self/mountinfo, the 5th field.
+ * Special chars in there are escaped as octal numbers, ie. ' ' as '\040'.
+ */
+std::set<std::string> MountPoints() {
+  std::set<std::string> result;
+  std::ifstream is("/proc/self/mountinfo");
+  std::string line;
+
+  while(std::getline(is, line)) {
+     std::istringstream ss(line);
+     std::string id, parent, devnum, root, mountpoint, s;
+     if (!(ss >> id >> parent >> devnum >> root >> mountpoint))
+        continue;
+     for(size_t i = 0; i < mountpoint.size(); i++) {
+        if (mountpoint[i] == '\\' and (i+3) < mountpoint.size()) {
+           s += (char) std::stoi(mountpoint.substr(i+1, 3), nullptr, 8);
+           i += 3;
+           }
+        else
+           s += mountpoint[i];
+        }
+     result.insert(s);
+     }
+  return result;
+}
+
+/* true, if Path is the root of a file system of its own, ie. not an empty
+ * mount point on the parent file system. */
+bool IsMountPoint(std::string_view Path) {
+  struct stat st, parent;
+  std::string p(Path);
+  if (stat(PathBuf(p).c_str(), &st) or stat(PathBuf(p + "/..").c_str(), &parent))
+     return false;
+  return st.st_dev != parent.st_dev or st.st_ino == parent.st_ino;
+}
+
+/* Returns the /sys/dev/block/../stat file of the block device holding Path,
+ * or an empty string. For a partition, the one of the whole disk, as the
+ * whole disk spins down.
+ */
+std::string DiskStatFile(std::string_view Path) {
+  struct stat st;
+  if (stat(PathBuf(Path).c_str(), &st))
+     return "";
+
+  std::string dev("/sys/dev/block/" + std::to_string(major(st.st_dev)) + ':' + std::to_string(minor(st.st_dev)));
+  char* real = realpath(dev.c_str(), nullptr);
+  if (!real)
+     return "";
+
+  std::string s(real);
+  free(real);
+  if (FileExists(s + "/partition"))
+     s.erase(s.rfind('/'));
+  s += "/stat";
+  return FileExists(s)? s : "";
 }
 
-bool Rename(std::string From, std::string To) {
-  return rename(From.c_str(), To.c_str()) == 0;
+/* Sum of completed read and write requests and optionally the milliseconds
+ * spent doing I/O, see Documentation/block/stat.rst in the kernel sources.
+ */
+bool DiskIoCount(const std::string& StatFile, uint64_t& Count, uint64_t* Ticks) {
+  std::ifstream is(StatFile.c_str());
+  uint64_t reads, rmerges, rsectors, rticks, writes, wmerges, wsectors, wticks, inflight, ioticks;
+  if (!(is >> reads >> rmerges >> rsectors >> rticks >> writes))
+     return false;
+  Count = reads + writes;
+  if (Ticks) {
+     if (!(is >> wmerges >> wsectors >> wticks >> inflight >> ioticks))
+        return false;
+     *Ticks = ioticks;
+     }
+  return true;
+}
+
+/* The number of failed I/O requests of a SCSI or SATA disk, from device/ioerr_cnt
+ * next to StatFile; in hex, ie. '0x2'. false for other disks. */
+bool DiskIoErrors(const std::string& StatFile, uint64_t& Count) {
+  size_t slash = StatFile.rfind('/');
+  if (slash == std::string::npos)
+     return false;
+  std::ifstream is((StatFile.substr(0, slash) + "/device/ioerr_cnt").c_str());
+  return (bool) (is >> std::hex >> Count);
 }
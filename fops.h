@@ -4,22 +4,72 @@
  */
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
+#include <set>
+#include <cstdint>
+#include <climits>     /* PATH_MAX, NAME_MAX */
+#include <algorithm>   /* std::fill() */
 
-bool IsDirectory(std::string Name);
-bool IsSymlink(std::string Name);
-bool IsFile(std::string Name);
-bool IsVideoFile(std::string Name);
-bool EndsWith(std::string Name, std::string s);
+/* a null terminated copy of a std::string_view on the stack, for syscalls.
+ * A path too long for PATH_MAX is not truncated, which could hit another
+ * file; it's replaced by a single name longer than NAME_MAX instead, so that
+ * every syscall and libc function fails on it with ENAMETOOLONG. */
+class PathBuf {
+private:
+  char s[PATH_MAX];
+public:
+  PathBuf(std::string_view v) {
+     if (v.size() < sizeof(s))
+        s[v.copy(s, v.size())] = 0;
+     else {
+        std::fill(s, s + NAME_MAX + 1, 'x');
+        s[NAME_MAX + 1] = 0;
+        }
+     }
+  const char* c_str() const { return s; }
+};
 
-bool SymLink(std::string LinkName, std::string LinkDest, bool DryRun = false);
-std::string LinkDest(std::string Name);
-std::string FlatPath(std::string Path);
+bool IsDirectory(std::string_view Name);
+bool IsSymlink(std::string_view Name);
+bool IsFile(std::string_view Name);
+bool IsVideoFile(std::string_view Name);
+bool EndsWith(std::string_view Name, std::string_view s);
 
-void CopyFile(std::string From, std::string To, bool DryRun = false);
-void MoveFile(std::string From, std::string To, bool DryRun = false);
-bool Remove(std::string Filename, bool DryRun = false);
-size_t FileSize(std::string Name);
-bool MakeDirectory(std::string Name, bool Parents = true, bool DryRun = false);
-bool Rename(std::string From, std::string To);
+bool SymLink(std::string_view LinkName, std::string_view LinkDest, bool DryRun = false);
+bool ReplaceSymLink(std::string_view LinkName, std::string_view LinkDest);
+std::string LinkDest(std::string_view Name);
+std::string_view LinkDest(std::string_view Name, char* Buffer, size_t Size);
+std::string FlatPath(std::string_view Path);
+
+void CopyFile(std::string_view From, std::string_view To, bool DryRun = false);
+bool IsCopying(std::string_view Name);
+
+/* Name counts as IsCopying() while this exists, ie. for reads of a background
+ * task other than CopyFile(); the prefetcher ignores them. */
+class CopyingFile {
+private:
+  std::string name;
+public:
+  CopyingFile(std::string_view Name);
+  ~CopyingFile();
+};
+
+void MoveFile(std::string_view From, std::string_view To, bool DryRun = false);
+bool Remove(std::string_view Filename, bool DryRun = false);
+size_t FileSize(std::string_view Name);
+bool MakeDirectory(std::string_view Name, bool Parents = true, bool DryRun = false);
+bool Rename(std::string_view From, std::string_view To);
+bool WriteSync(int File, std::string_view Text);
+bool WriteFile(const std::string& FileName, const std::string& Text);
+bool SyncFile(std::string_view Name);
+bool SyncDirectory(std::string_view Name);
+bool RelinkFile(std::string_view LinkName, std::string_view From, std::string_view To);
+bool RelinkFile(const std::vector<std::string>& LinkNames, std::string_view From, std::string_view To);
+time_t FileAge(std::string_view Name);
+std::set<std::string> MountPoints();
+bool IsMountPoint(std::string_view Path);
+std::string DiskStatFile(std::string_view Path);
+bool DiskIoCount(const std::string& StatFile, uint64_t& Count, uint64_t* Ticks = nullptr);
+bool DiskIoErrors(const std::string& StatFile, uint64_t& Count);
@@ -0,0 +1,79 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <cmath>       /* exp() */
+#include "forecast.h"
+
+
+Forecast::Forecast(int WindowHours) : window(3600.0 * (WindowHours > 0? WindowHours : 1)) {
+  for(int i = 0; i < 256; i++) {
+     registered[i] = 0;
+     charRate[i] = 0;
+     }
+}
+
+void Forecast::Removed(const std::string& Disk, size_t Bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  disks[Disk].Removed += Bytes;
+}
+
+void Forecast::Sample(const std::string& Disk, const std::string& Chars, size_t Used, time_t Now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Series& s = disks[Disk];
+
+  if (!s.Last) {
+     s.Last = Now;
+     s.Used = Used;
+     s.Removed = 0;
+     for(char c:Chars)
+        registered[(uint8_t) c] = 0;
+     return;
+     }
+
+  double dt = Now - s.Last;
+  if (dt < MinInterval)
+     return;
+
+  /* exponential moving average for irregular intervals. */
+  double alpha = 1.0 - std::exp(-dt / window);
+  double net = ((double) Used - (double) s.Used) / dt;
+  s.Rate = s.Valid? s.Rate + alpha * (net - s.Rate) : net;
+  s.Valid = true;
+
+  double gross = (double) Used - (double) s.Used + (double) s.Removed;
+  if (gross < 0) gross = 0;
+  uint32_t total = 0;
+  uint32_t count[256] = { 0 };
+  for(char c:Chars)
+     total += count[(uint8_t) c] = registered[(uint8_t) c].exchange(0);
+  for(char c:Chars) {
+     double r = total? gross * count[(uint8_t) c] / total / dt : 0;
+     charRate[(uint8_t) c] += alpha * (r - charRate[(uint8_t) c]);
+     }
+
+  s.Last = Now;
+  s.Used = Used;
+  s.Removed = 0;
+}
+
+double Forecast::Rate(const std::string& Disk) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = disks.find(Disk);
+  return (it != disks.end() and it->second.Valid)? it->second.Rate : 0;
+}
+
+double Forecast::CharRate(char c) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return charRate[(uint8_t) c];
+}
+
+time_t Forecast::TimeToFull(const std::string& Disk, size_t Free, size_t Watermark) {
+  if (Free <= Watermark)
+     return 0;
+  double rate = Rate(Disk);
+  if (rate <= 0)
+     return -1;
+  return (Free - Watermark) / rate;
+}
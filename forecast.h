@@ -0,0 +1,53 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <ctime>
+#include <cstdint>
+
+/*******************************************************************************
+ * class Forecast
+ * Estimates how fast each disk fills up. The net growth of a disk is taken
+ * from regular samples of its used space. The bytes written in between, incl.
+ * the ones already deleted again, are split over the first chars of the
+ * recordings registered in that time, which gives a write rate per char.
+ * Both are smoothed over 'Window' hours, so a weekly series is not forgotten
+ * over night.
+ ******************************************************************************/
+class Forecast {
+private:
+  struct Series {
+     time_t Last = 0;
+     size_t Used = 0;
+     size_t Removed = 0;  /* bytes removed since Last. */
+     double Rate = 0;     /* net growth, bytes/s */
+     bool Valid = false;
+     };
+  std::mutex mutex;
+  std::map<std::string, Series> disks;
+  std::atomic<uint32_t> registered[256];
+  double charRate[256];   /* bytes/s written by recordings starting with a char. */
+  const double window;
+  static const time_t MinInterval = 3600;
+public:
+  Forecast(int WindowHours);
+
+  /* called from Register(); never locks. */
+  void Registered(char c) { registered[(uint8_t) c].fetch_add(1, std::memory_order_relaxed); }
+  void Removed(const std::string& Disk, size_t Bytes);
+
+  /* Chars: the chars mapped to Disk. Samples closer than MinInterval are ignored. */
+  void Sample(const std::string& Disk, const std::string& Chars, size_t Used, time_t Now);
+
+  double Rate(const std::string& Disk);
+  double CharRate(char c);
+
+  /* seconds until Free drops below Watermark, 0 if already below,
+   * or -1 if the disk doesn't grow. */
+  time_t TimeToFull(const std::string& Disk, size_t Free, size_t Watermark);
+};
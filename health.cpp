@@ -0,0 +1,131 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include "health.h"
+
+namespace Health {
+  static const int Slots = 6;
+  static const time_t SlotTime = 600;
+
+  struct Slot {
+     time_t Start = 0;
+     uint64_t Ops = 0;
+     uint64_t Errors = 0;
+     double Max = 0;
+     uint32_t Histogram[Buckets] = { 0 };
+     };
+
+  struct DiskStats {
+     Slot slots[Slots];
+     Slot& Current(time_t Now) {
+        time_t start = Now - Now % SlotTime;
+        Slot& s = slots[(Now / SlotTime) % Slots];
+        if (s.Start != start)
+           s = Slot{start};
+        return s;
+        }
+     };
+
+  static std::mutex mutex;
+  static std::map<std::string, DiskStats, std::less<>> disks;
+
+  /* the upper bound of a bucket in ms. */
+  static double Bound(int Bucket) {
+    return (double) (1U << Bucket);
+  }
+}
+
+void Health::Watch(const std::vector<std::string>& Disks) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for(auto& d:Disks)
+     disks[d];
+}
+
+void Health::Record(std::string_view Path, uint64_t Nanos, bool Ok, bool Timed) {
+  double ms = Nanos / 1e6;
+  int bucket = 0;
+  while(bucket < (Buckets - 1) and ms >= Bound(bucket))
+     bucket++;
+  time_t now = time(nullptr);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = disks.find(Path);
+  if (it == disks.end()) {
+     size_t slash = Path.rfind('/');
+     if (slash == std::string_view::npos or (it = disks.find(Path.substr(0, slash))) == disks.end())
+        return;
+     }
+  Slot& s = it->second.Current(now);
+  if (!Timed) {
+     if (!Ok) s.Errors++;
+     return;
+     }
+  s.Ops++;
+  s.Histogram[bucket]++;
+  s.Max = std::max(s.Max, ms);
+  if (!Ok)
+     s.Errors++;
+}
+
+void Health::Errors(const std::string& Disk, uint64_t Count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = disks.find(Disk);
+  if (it != disks.end())
+     it->second.Current(time(nullptr)).Errors += Count;
+}
+
+Health::Summary Health::Get(const std::string& Disk) {
+  Summary result;
+  time_t now = time(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = disks.find(Disk);
+    if (it == disks.end())
+       return result;
+    for(auto& s:it->second.slots) {
+       if ((now - s.Start) >= Slots * SlotTime)
+          continue;
+       result.Ops    += s.Ops;
+       result.Errors += s.Errors;
+       result.Max     = std::max(result.Max, s.Max);
+       for(int i = 0; i < Buckets; i++)
+          result.Histogram[i] += s.Histogram[i];
+       }
+  }
+
+  uint64_t count = 0;
+  for(int i = 0; i < Buckets and result.Ops; i++) {
+     count += result.Histogram[i];
+     if (!result.P50 and count * 2 >= result.Ops)
+        result.P50 = std::min(Bound(i), result.Max);
+     if (!result.P95 and count * 20 >= result.Ops * 19)
+        result.P95 = std::min(Bound(i), result.Max);
+     }
+  return result;
+}
+
+void Health::Reset(const std::string& Disk) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = disks.find(Disk);
+  if (it != disks.end())
+     it->second = DiskStats{};
+}
+
+std::string Health::Text(const Summary& s) {
+  std::stringstream ss;
+  for(int i = 0; i < Buckets; i++) {
+     if (!s.Histogram[i]) continue;
+     if (ss.tellp() > 0) ss << ' ';
+     if (i < (Buckets - 1))
+        ss << '<' << Bound(i) << ':' << s.Histogram[i];
+     else
+        ss << '>' << Bound(i - 1) << ':' << s.Histogram[i];
+     }
+  return ss.str();
+}
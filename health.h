@@ -0,0 +1,47 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+
+/*******************************************************************************
+ * namespace Health
+ * Latencies and errors of the I/O done on each disk, as histograms over the
+ * last hour in six slots of ten minutes; a slot is cleared once it's reused.
+ * Operations on files of unknown disks are ignored, see Watch().
+ ******************************************************************************/
+namespace Health {
+  static const int Buckets = 16;    /* bucket i: latencies below 2^i ms; the last one all above. */
+
+  struct Summary {
+     uint64_t Ops = 0;
+     uint64_t Errors = 0;
+     double P50 = 0;                /* ms, the upper bound of the bucket. */
+     double P95 = 0;
+     double Max = 0;
+     uint32_t Histogram[Buckets] = { 0 };
+     };
+
+  /* the disks to record; a disk once added is kept. */
+  void Watch(const std::vector<std::string>& Disks);
+
+  /* one operation on Path, a disk or a file on a disk. !Timed: only an error
+   * counts, not the latency; ie. the first I/O on a sleeping disk, which
+   * includes its spin up.
+   */
+  void Record(std::string_view Path, uint64_t Nanos, bool Ok, bool Timed = true);
+
+  /* errors reported by the kernel, ie. from sysfs. */
+  void Errors(const std::string& Disk, uint64_t Count);
+
+  Summary Get(const std::string& Disk);
+  void Reset(const std::string& Disk);
+
+  /* '<1:12 <2:3 ..', the non-empty buckets. */
+  std::string Text(const Summary& s);
+}
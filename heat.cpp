@@ -0,0 +1,101 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>       /* exp2() */
+#include "heat.h"
+#include "fops.h"
+
+
+HeatMap::HeatMap(int HalfLifeDays) : halflife(86400.0 * (HalfLifeDays > 0? HalfLifeDays : 1)), changed(false) {}
+
+double HeatMap::Decayed(const Entry& e, time_t Now) const {
+  if (Now <= (time_t) e.Last)
+     return e.Heat;
+  return e.Heat * std::exp2(-(Now - (time_t) e.Last) / halflife);
+}
+
+/* drops the coldest entries. Needs mutex locked. */
+void HeatMap::Compact(time_t Now) {
+  for(auto it = entries.begin(); it != entries.end();)
+     it = Decayed(it->second, Now) < MinHeat? entries.erase(it) : ++it;
+}
+
+void HeatMap::Touch(const std::string& Recording, time_t Now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Entry& e = entries[Recording];
+  if (e.Last and (Now - (time_t) e.Last) < Session)
+     return;
+  e.Heat = Decayed(e, Now) + 1;
+  e.Last = Now;
+  changed = true;
+  if (entries.size() > MaxEntries)
+     Compact(Now);
+}
+
+double HeatMap::Heat(const std::string& Recording, time_t Now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(Recording);
+  return it == entries.end()? 0 : Decayed(it->second, Now);
+}
+
+void HeatMap::Rename(const std::string& From, const std::string& To) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(From);
+  if (it == entries.end() or From == To)
+     return;
+  entries[To] = it->second;
+  entries.erase(it);
+  changed = true;
+}
+
+std::vector<std::pair<double, std::string>> HeatMap::Ranking(time_t Now) {
+  std::vector<std::pair<double, std::string>> result;
+  std::lock_guard<std::mutex> lock(mutex);
+  Compact(Now);
+  for(auto& e:entries)
+     result.push_back(std::make_pair(Decayed(e.second, Now), e.first));
+  std::sort(result.rbegin(), result.rend());
+  return result;
+}
+
+bool HeatMap::Load(const std::string& FileName) {
+  std::ifstream is(FileName);
+  if (!is)
+     return false;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string line;
+  while(std::getline(is, line)) {
+     std::istringstream ls(line);
+     Entry e;
+     std::string name;
+     if (ls >> e.Heat >> e.Last and ls.get() == ' ' and std::getline(ls, name) and !name.empty())
+        entries[name] = e;
+     }
+  Compact(time(nullptr));
+  changed = false;
+  return true;
+}
+
+/* only if anything changed since the last call. */
+bool HeatMap::Save(const std::string& FileName) {
+  std::stringstream ss;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!changed)
+       return true;
+    Compact(time(nullptr));
+    for(auto& e:entries)
+       ss << e.second.Heat << ' ' << e.second.Last << ' ' << e.first << '\n';
+    changed = false;
+  }
+  if (WriteFile(FileName, ss.str()))
+     return true;
+  std::lock_guard<std::mutex> lock(mutex);
+  changed = true;
+  return false;
+}
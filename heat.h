@@ -0,0 +1,52 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <ctime>
+#include <cstdint>
+
+/*******************************************************************************
+ * class HeatMap
+ * How often each recording is replayed. A recording is known by the flat name
+ * of its files w/o segment, ie. 'name~date~', which doesn't change on a move
+ * to another disk; Move() renames the files, and with them the entry. Each
+ * replay adds one; the sum halves every
+ * 'HalfLife' days, so a series watched last year cools down by itself.
+ * Entries, which are nearly cold, are dropped.
+ ******************************************************************************/
+class HeatMap {
+private:
+  struct Entry {
+     float Heat = 0;
+     uint32_t Last = 0;   /* time of last replay. */
+     };
+  std::mutex mutex;
+  std::map<std::string, Entry> entries;
+  const double halflife;
+  bool changed;
+  double Decayed(const Entry& e, time_t Now) const;
+  void Compact(time_t Now);
+  static constexpr double MinHeat = 0.05;
+  static const time_t Session = 3600;    /* reads closer than that are one replay. */
+  static const size_t MaxEntries = 20000;
+public:
+  HeatMap(int HalfLifeDays);
+
+  /* Recording is read now. */
+  void Touch(const std::string& Recording, time_t Now);
+  double Heat(const std::string& Recording, time_t Now);
+  /* the recording From is now known as To; its heat goes with it. */
+  void Rename(const std::string& From, const std::string& To);
+
+  /* all recordings, hottest first. */
+  std::vector<std::pair<double, std::string>> Ranking(time_t Now);
+
+  /* text file, one 'heat time name' per line. */
+  bool Load(const std::string& FileName);
+  bool Save(const std::string& FileName);
+};
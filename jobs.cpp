@@ -0,0 +1,76 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <sstream>
+#include "jobs.h"
+
+static const size_t MaxLines = 1000;
+
+
+void JobInfo::Print(std::string Line) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (output.size() == MaxLines)
+     output.pop_front();
+  output.push_back(Line);
+}
+
+void JobInfo::Finish() {
+  std::lock_guard<std::mutex> lock(mutex);
+  end = time(nullptr);
+  done = true;
+}
+
+std::string JobInfo::Status(bool WithOutput) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::stringstream ss;
+  ss << Id << ' ' << Command << ' '
+     << (done? (cancel? "cancelled" : "done") : (cancel? "cancelling" : "running"))
+     << ' ' << ((done? end : time(nullptr)) - Start) << 's';
+  if (WithOutput)
+     for(auto& l:output)
+        ss << '\n' << l;
+  return ss.str();
+}
+
+
+std::shared_ptr<JobInfo> JobList::New(std::string Command) {
+  std::lock_guard<std::mutex> lock(mutex);
+  time_t now = time(nullptr);
+
+  for(auto it = jobs.begin(); it != jobs.end();) {
+     if (it->second->Done() and (now - it->second->End()) > 3600)
+        it = jobs.erase(it);
+     else
+        ++it;
+     }
+
+  auto job = std::make_shared<JobInfo>(next++, Command);
+  jobs[job->Id] = job;
+  return job;
+}
+
+std::shared_ptr<JobInfo> JobList::Get(int Id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = jobs.find(Id);
+  return it != jobs.end()? it->second : nullptr;
+}
+
+std::string JobList::List() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string s;
+  for(auto& j:jobs) {
+     if (!s.empty()) s += '\n';
+     s += j.second->Status(false);
+     }
+  return s.empty()? "no jobs" : s;
+}
+
+size_t JobList::Running() {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t n = 0;
+  for(auto& j:jobs)
+     if (!j.second->Done()) n++;
+  return n;
+}
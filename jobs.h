@@ -0,0 +1,57 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <ctime>
+
+/*******************************************************************************
+ * class JobInfo
+ * State and output of one long running SVDRP command, ie. BALANCE.
+ * Written by the background thread, read by the SVDRP thread.
+ ******************************************************************************/
+class JobInfo {
+private:
+  std::mutex mutex;
+  std::deque<std::string> output;
+  std::atomic<bool> cancel;
+  std::atomic<bool> done;
+  time_t end;
+public:
+  const int Id;
+  const std::string Command;
+  const time_t Start;
+  JobInfo(int id, std::string command) : cancel(false), done(false), end(0),
+     Id(id), Command(command), Start(time(nullptr)) {}
+  void Print(std::string Line);
+  void Cancel()          { cancel = true; }
+  bool Cancelled() const { return cancel; }
+  void Finish();
+  bool Done() const      { return done; }
+  time_t End() const     { return end; }
+  std::string Status(bool WithOutput);
+};
+
+/*******************************************************************************
+ * class JobList
+ * All jobs started by SVDRP; finished jobs are kept for an hour.
+ ******************************************************************************/
+class JobList {
+private:
+  std::mutex mutex;
+  std::map<int, std::shared_ptr<JobInfo>> jobs;
+  int next;
+public:
+  JobList() : next(1) {}
+  std::shared_ptr<JobInfo> New(std::string Command);
+  std::shared_ptr<JobInfo> Get(int Id);
+  std::string List();
+  size_t Running();
+};
@@ -0,0 +1,135 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include <cstring>      /* strncpy() */
+#include <unistd.h>     /* close(), unlink() */
+#include <poll.h>       /* poll() */
+#include <sys/socket.h> /* socket() */
+#include <sys/un.h>     /* sockaddr_un */
+#include "metrics.h"
+
+
+/*******************************************************************************
+ * per thread counters.
+ ******************************************************************************/
+namespace {
+  struct alignas(64) Shard {
+     std::atomic<uint64_t> Values[Metrics::CounterCount];
+     Shard() { for(auto& v:Values) v = 0; }
+     };
+
+  /* all live shards and the sums of threads already gone.
+   * Never destroyed, as threads may still exit during program end.
+   */
+  struct Registry {
+     std::mutex Mutex;
+     std::vector<Shard*> Shards;
+     uint64_t Retired[Metrics::CounterCount] = {};
+     };
+
+  Registry& Reg() {
+     static Registry* r = new Registry;
+     return *r;
+  }
+
+  struct LocalShard {
+     Shard* s;
+     LocalShard() : s(new Shard) {
+        std::lock_guard<std::mutex> lock(Reg().Mutex);
+        Reg().Shards.push_back(s);
+        }
+     ~LocalShard() {
+        std::lock_guard<std::mutex> lock(Reg().Mutex);
+        for(int i = 0; i < Metrics::CounterCount; i++)
+           Reg().Retired[i] += s->Values[i];
+        auto& v = Reg().Shards;
+        v.erase(std::remove(v.begin(), v.end(), s), v.end());
+        delete s;
+        }
+     };
+
+  thread_local LocalShard Local;
+}
+
+/* only the owning thread writes its shard, so no atomic read-modify-write. */
+void Metrics::Add(Counter c, uint64_t n) {
+  auto& v = Local.s->Values[c];
+  v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Get(Counter c) {
+  std::lock_guard<std::mutex> lock(Reg().Mutex);
+  uint64_t sum = Reg().Retired[c];
+  for(auto s:Reg().Shards)
+     sum += s->Values[c].load(std::memory_order_relaxed);
+  return sum;
+}
+
+
+/*******************************************************************************
+ * class MetricsSocket
+ ******************************************************************************/
+MetricsSocket::MetricsSocket(std::string Path, std::function<std::string()> Provider) :
+   path(Path), provider(Provider), running(false), fd(-1) {
+  sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path)) {
+     std::cerr << "MetricsSocket: path too long: " << path << std::endl;
+     return;
+     }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+     return;
+
+  unlink(path.c_str());
+  if (bind(fd, (sockaddr*) &addr, sizeof(addr)) or listen(fd, 4)) {
+     std::cerr << "MetricsSocket: cannot listen on " << path << std::endl;
+     close(fd);
+     fd = -1;
+     return;
+     }
+  running = true;
+  thread = std::thread(&MetricsSocket::Action, this);
+}
+
+MetricsSocket::~MetricsSocket() {
+  running = false;
+  if (thread.joinable())
+     thread.join();
+  if (fd >= 0) {
+     close(fd);
+     unlink(path.c_str());
+     }
+}
+
+void MetricsSocket::Action() {
+  while(running) {
+     pollfd p = { fd, POLLIN, 0 };
+     if (poll(&p, 1, 1000) <= 0)
+        continue;
+
+     int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+     if (client < 0)
+        continue;
+
+     std::string Text = provider();
+     const char* s = Text.data();
+     size_t left = Text.size();
+     while(left) {
+        ssize_t n = send(client, s, left, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        s += n;
+        left -= n;
+        }
+     close(client);
+     }
+}
@@ -0,0 +1,67 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+/*******************************************************************************
+ * namespace Metrics
+ * Counters for monitoring. Each thread adds to its own set of counters, so the
+ * hot paths neither lock nor share cache lines; Get() sums up all threads.
+ ******************************************************************************/
+namespace Metrics {
+  enum Counter {
+     RegisterCalls,
+     RegisterNanos,
+     ContainsCalls,
+     ContainsNanos,
+     FilesCopied,
+     BytesCopied,
+     CopyNanos,
+     BalanceRuns,
+     CounterCount
+     };
+
+  void Add(Counter c, uint64_t n = 1);
+  uint64_t Get(Counter c);
+
+  /* adds one call and the time spent in scope. */
+  class Timer {
+  private:
+     Counter calls, nanos;
+     std::chrono::steady_clock::time_point start;
+  public:
+     Timer(Counter Calls, Counter Nanos) : calls(Calls), nanos(Nanos),
+        start(std::chrono::steady_clock::now()) {}
+     ~Timer() {
+        Add(calls);
+        Add(nanos, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start).count());
+        }
+  };
+}
+
+/*******************************************************************************
+ * class MetricsSocket
+ * Listens on a local unix socket and sends the text from Provider to every
+ * client, then closes the connection. ie.: socat - UNIX-CONNECT:<path>
+ ******************************************************************************/
+class MetricsSocket {
+private:
+  std::string path;
+  std::function<std::string()> provider;
+  std::atomic<bool> running;
+  std::thread thread;
+  int fd;
+  void Action();
+public:
+  MetricsSocket(std::string Path, std::function<std::string()> Provider);
+  ~MetricsSocket();
+  bool Active() const { return fd >= 0; }
+};
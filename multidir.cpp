@@ -5,21 +5,47 @@
 #include <string>
 #include <vector>
 #include <sstream>
+#include <iomanip>
+#include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <tuple>
+#include <set>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <chrono>
 #include <cstdio>      /* remove() */
 #include <cmath>       /* lround() */
 #include <cstdint>     /* uint8_t */
+#include <cstdlib>     /* atoi() */
+#include <cstring>     /* strcmp() */
+#include <cerrno>      /* errno */
+#include <ctime>       /* time() */
 #include <sys/types.h> /* stat() */
 #include <sys/stat.h>  /* stat() */
 #include <unistd.h>    /* stat() */
+#include <fcntl.h>     /* open() */
 #include <sys/statvfs.h>
 #include <repfunc.h>
 #include "multidir.h"
 #include "vdirs.h"
 #include "fops.h"
 #include "workqueue.h"
+#include "dirwalk.h"
+#include "pathstore.h"
+#include "services.h"
+#include "metrics.h"
+#include "forecast.h"
+#include "prefetch.h"
+#include "heat.h"
+#include "health.h"
+#include "dedup.h"
+#include "balance.h"
 
 
 extern class cPluginVdirs* PluginVdirs;
@@ -31,24 +57,91 @@ const size_t gibibyte = 0x40000000;
 /*******************************************************************************
  * class DiskInfo
  * Holds info about one of the mounted Disks.
+ * Read by any thread w/o locking; therefore all members, which change later
+ * on, are atomic. The ones at the end only with Equalizer::Mutex locked.
  ******************************************************************************/
 class DiskInfo {
 public:
-  std::string Path;
-  size_t Free;
-  size_t Total;
-  size_t Used;
+  const std::string Path;
+  const int Number;
+  const std::string StatFile;  /* power management, only if StatFile is known. */
+  std::atomic<size_t> Free;
+  std::atomic<size_t> Total;
+  std::atomic<size_t> Used;
+  std::atomic<bool> Online;
+  std::atomic<bool> ReadOnly;
+  std::atomic<bool> Draining;  /* no new files, data is moved off. */
+  std::atomic<bool> SpaceValid;
+  std::atomic<uint64_t> SpaceIo;  /* I/O count at last statvfs() */
+  std::atomic<time_t> LastIo;
+  std::atomic<unsigned> Busy;     /* per mille of time doing I/O, since last PollPower(). */
+  std::atomic<time_t> PlayedUntil; /* replay; background transfers wait. */
+  std::atomic<bool> Degraded;  /* too many errors or too slow; like Draining, until a clean hour. */
+  uint64_t IoCount;
+  uint64_t IoTicks;
+  time_t LastPoll;
+  size_t Wakeups;
+  std::map<std::string, Job> Deferred;   /* link -> job */
+  time_t DeferredSince;
+  uint64_t IoErrors;    /* ioerr_cnt at last PollPower(); UINT64_MAX: not yet read. */
+  std::string Reason;   /* why the disk is degraded. */
+  bool DrainQueued;     /* the drain of a degraded disk was queued. */
+  time_t DegradedSince;
+  static time_t SpinDown;   /* Equalizer::IdleTime, for GetSpace() */
 public:
-  DiskInfo(std::string path) : Path(path), Free(0), Total(0), Used(0) {}
-
+  DiskInfo(std::string path, int number, std::string statfile = "") :
+     Path(path), Number(number), StatFile(statfile), Free(0), Total(0), Used(0),
+     Online(false), ReadOnly(false), Draining(false), SpaceValid(false),
+     SpaceIo(0), LastIo(time(nullptr)), Busy(0), PlayedUntil(0), Degraded(false),
+     IoCount(0), IoTicks(0), LastPoll(0), Wakeups(0), DeferredSince(0), IoErrors(UINT64_MAX),
+     DrainQueued(false), DegradedSince(0) {}
+
+  /* The free space can't change without I/O on that disk. Therefore,
+   * statvfs() is only called if there was I/O since last call, which
+   * avoids waking up a sleeping disk.
+   */
   bool GetSpace() {
+     uint64_t io;
+     bool power = !StatFile.empty() and DiskIoCount(StatFile, io);
+     if (power and SpaceValid and io == SpaceIo)
+        return true;
+
+     /* a sleeping disk first spins up; that's no latency of its own. */
+     bool asleep = Sleeping(SpinDown);
      struct statvfs s;
-     if (statvfs(Path.c_str(), &s)) return false;
+     auto start = std::chrono::steady_clock::now();
+     bool failed = statvfs(Path.c_str(), &s) != 0;
+     Health::Record(Path, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start).count(), !failed, !asleep);
+     if (failed) return false;
      Free  = s.f_bsize * s.f_bavail;
      Total = s.f_bsize * s.f_blocks;
      Used  = Total - Free;
+     ReadOnly = (s.f_flag & ST_RDONLY) != 0;
+     SpaceValid = true;
+     if (power and DiskIoCount(StatFile, io)) SpaceIo = io;
      return true;
      }
+
+  bool Writable() { return Online and !ReadOnly and !Draining and !Degraded; }
+  bool Sleeping(time_t IdleTime) { return !StatFile.empty() and (time(nullptr) - LastIo) >= IdleTime; }
+};
+
+time_t DiskInfo::SpinDown = 0;
+
+typedef std::shared_ptr<DiskInfo> DiskPtr;
+
+
+/*******************************************************************************
+ * struct Placement
+ * Everything Register() and FreeMB() need to know. Never changed once
+ * published; a new one replaces the current one atomically.
+ ******************************************************************************/
+struct Placement {
+  std::string DiskSeq;
+  std::vector<std::string> DiskChars;
+  std::vector<DiskPtr> Disks;
+  DiskPtr Ssd;
 };
 
 
@@ -59,243 +152,1036 @@ public:
 class Equalizer {
 friend MultiVideoDir;
 private:
-  std::string alphabet;
   std::string Prefix;
   std::string DiskSeq;
   std::vector<std::string> DiskChars;
-  std::vector<class DiskInfo*> Disks;
-  size_t DiskUsePerChar[256];
-  WorkQueue<CopyData, void(*)(CopyData&)>* BgTask;
-  WorkQueue<ImportData, void(*)(ImportData&)>* BgImportTask;
+  std::vector<DiskPtr> Disks;
+  DiskPtr Ssd;
+  std::shared_ptr<const Placement> placement;
+  size_t SsdMinAge;
+  size_t SsdMinFree;
+  time_t IdleTime;
+  time_t MaxDefer;
+  size_t MinFree;
+  time_t Horizon;
+  size_t HealthMaxErrors;
+  double HealthMaxLatency;
+  bool HealthDrain;
+  int BalanceFrom;
+  int BalanceTo;
+  int Stripe;
+  size_t StripeMinRate;
+  Forecast Growth;
+  HeatMap Heat;
+  std::set<int> HotDisks;
+  double HotReplays;
+  size_t HotBudget;
+  double HotAllowance;   /* bytes left of HotBudget; refilled continuously. */
+  time_t HotRefill;
+  std::unique_ptr<Prefetcher> Prefetch;
+  std::mutex Mutex;
+  std::set<std::string> Mounts;
+  SharedFiles Shared;
+  WorkerPool Pool;
+  WorkQueue<DrainData, std::function<void(DrainData&)>>* BgDrainTask;
+  WorkQueue<Job, void(*)(Job&)>* BgJobs;
+  WorkQueue<Job, void(*)(Job&)>* BgCommands;
 
-  void Reset() { for(int i=0; i<256; i++) DiskUsePerChar[i] = 0; }
   void InitDisks();
-  void Add(std::string Path);
-  void BgCopy(std::string From, std::string To);
-  void BgMove(std::string From, std::string To);
-  void BgImport(std::string videodir, std::string Disk, std::string Src, std::string Dir);
+  std::set<int> DiskNumbers();
+  void Publish();
+  std::shared_ptr<const Placement> Current() const { return std::atomic_load(&placement); }
+  DiskPtr ProbeDisk(int Number, bool Startup = false);
+  void ProbeSsd();
+  void DrainWork(DrainData& d);
+  void Replay(const std::string& Disk);
+  bool Played(std::string_view File);
+  bool Relink(const std::string& Link, const std::string& From, const std::string& To, time_t& Wait);
+  bool Relink(const std::string& Link, const std::string& From, const std::string& To) { time_t w = 0; return Relink(Link, From, To, w); }
+  bool Defer(std::string Disk, std::string Key, Job j, bool Always = false);
+  bool Fast(std::string_view Disk);
+  bool Pinned(std::string_view File);
+  void Add(const DirSnapshot& Files, size_t* DiskUsePerChar, const std::set<std::string_view>& Stripes, size_t& StripedUse);
 
 public:
-  Equalizer(std::string DiskPrefix, std::string Seq);
+  Equalizer(const VdirsSetup& Setup);
   ~Equalizer();
   std::string SplitEqual();
   void        DiskSpace(size_t& Free, size_t& Used);
-  size_t      NumDisks() { return Disks.size(); }
+  size_t      NumDisks() { return Current()->Disks.size(); }
   void        Initialize();
-  void        Equalize(bool forced = false);
+  void        Equalize(JobInfo& job, bool forced = false);
   std::string Storage(char c);
-  static char CharMapping(std::string s);
-  bool        ValidSequence() { return Disks.size() == DiskChars.size(); }
+  std::string Landing(std::string_view File, char c);
+  std::string Target(std::string_view File, char c);
+  bool        Striped(std::string_view File, int Segment);
+  std::string StripeDisk(char c, int Segment);
+  static int  Segment(std::string_view File);
+  void        MigrateSsd(std::string videodir);
+  static char CharMapping(std::string_view s) { return ::CharMapping(s); }
+  bool        ValidSequence() { auto p = Current(); return p->Disks.size() == p->DiskChars.size(); }
+  bool        Rescan();
+  std::string AddDisk(int Number);
+  std::string DrainDisk(std::string videodir, int Number, bool& Busy);
+  std::string DiskStatus();
+  void        PollPower();
+  bool        Background(Job j) { return BgCommands->TryPush(std::move(j)); }
+  std::vector<std::string> DiskPaths();
+  void        DiskList(std::vector<Vdirs_DiskInfo_v1_0::Disk>& Result);
+  size_t      Queued();
+  size_t      DeferredJobs();
+  std::vector<std::pair<std::string, double>> Startup;  /* ms per step of constructor. */
+  std::string PoolStatus() { return Pool.Status(); }
+  std::string Sequence() { return Current()->DiskSeq; }
+  void        Registered(char c) { Growth.Registered(c); }
+  void        Removed(std::string Disk, size_t Bytes) { Growth.Removed(Disk, Bytes); }
+  void        SampleGrowth();
+  bool        BalanceTime();
+  std::vector<std::string> RunningShort();
+  bool        Relieve(std::string videodir, std::string Disk);
+  std::string ForecastStatus();
+  void        CheckHealth(std::string videodir);
+  std::string HealthStatus();
+  void        MoveHot(std::string videodir, JobInfo& job);
+  std::string HeatStatus();
+  bool        HotEnabled() { return !HotDisks.empty(); }
+  void        LoadHeat(const std::string& FileName) { if (HotEnabled()) Heat.Load(FileName); }
+  bool        SaveHeat(const std::string& FileName) { return !HotEnabled() or Heat.Save(FileName); }
 };
 
 
-Equalizer::Equalizer(std::string DiskPrefix, std::string Seq) :
-    alphabet("0123456789abcdefghijklmnopqrstuvwxyz"),
-    Prefix(DiskPrefix), DiskSeq(Seq)
+/* The flat name of a file without its segment, ie. 'name~date~' for
+ * 'name~date~00002.ts'; equal for all files of one recording. */
+static std::string_view Recording(const char* FlatName) {
+  std::string_view s(FlatName);
+  return s.substr(0, s.rfind('~') + 1);
+}
+
+
+Equalizer::Equalizer(const VdirsSetup& Setup) :
+    Prefix(Setup.MountPrefix), DiskSeq(Setup.DiskSeq), Ssd(nullptr),
+    SsdMinAge(Setup.SsdMinAge * 60), SsdMinFree(Setup.SsdMinFree * gibibyte),
+    IdleTime(Setup.SpinDown * 60), MaxDefer(Setup.MaxDefer * 3600),
+    MinFree(Setup.BalanceMinFree * gibibyte), Horizon(Setup.ForecastHorizon * 3600),
+    HealthMaxErrors(Setup.HealthMaxErrors), HealthMaxLatency(Setup.HealthMaxLatency),
+    HealthDrain(Setup.HealthDrain),
+    BalanceFrom(Setup.BalanceFrom), BalanceTo(Setup.BalanceTo),
+    Stripe(Setup.Stripe), StripeMinRate(Setup.StripeMinRate * mebibyte), Growth(Setup.ForecastWindow),
+    Heat(Setup.HeatHalfLife), HotReplays(Setup.HotReplays), HotBudget(Setup.HotBudget * gibibyte),
+    HotAllowance(0), HotRefill(time(nullptr))
 {
-  Reset();
+  auto t = std::chrono::steady_clock::now();
+  auto lap = [this, &t](const char* Step) {
+     auto now = std::chrono::steady_clock::now();
+     Startup.push_back(std::make_pair(Step, std::chrono::duration<double, std::milli>(now - t).count()));
+     t = now;
+     };
+
+  DiskInfo::SpinDown = IdleTime;
+  if (!Setup.Ssd.empty())
+     Ssd = std::make_shared<DiskInfo>(Setup.Ssd, -1);
+  std::stringstream hot(Setup.HotDisks);
+  for(std::string n; std::getline(hot, n, ',');)
+     if (n.find_first_of("0123456789") != std::string::npos)
+        HotDisks.insert(std::atoi(n.c_str()));
   Initialize();
   InitDisks();
-  BgTask = new WorkQueue<CopyData, void(*)(CopyData&)>(&CopyWork);
-  BgImportTask = new WorkQueue<ImportData, void(*)(ImportData&)>(&ImportWork);
+  lap("disks");
+
+  /* no threads yet; they are started by the pool on first use. */
+  BgDrainTask = new WorkQueue<DrainData, std::function<void(DrainData&)>>(Pool,
+     [this](DrainData& d) { DrainWork(d); }, 1);
+  BgJobs = new WorkQueue<Job, void(*)(Job&)>(Pool, &RunJob, 1);
+  BgCommands = new WorkQueue<Job, void(*)(Job&)>(Pool, &RunJob, 2);
+  lap("queues");
+
+  /* the prefetcher also reports the replays for the heat map. */
+  if (Setup.Prefetch > 0 or HotEnabled()) {
+     Prefetch.reset(new Prefetcher(cVideoDirectory::Name(), std::max(0, Setup.Prefetch) * mebibyte,
+        [this](const std::string& Disk, const std::string& File) {
+           Replay(Disk);
+           std::string_view name(Recording(File.c_str()));
+           if (HotEnabled() and !name.empty())
+              Heat.Touch(std::string(name), time(nullptr));
+           }));
+     Prefetch->Watch(DiskPaths());
+     lap("prefetch");
+     }
 }
 
+/* jobs may queue more work, ie. BgCommands -> BgDrainTask; so they go first. */
 Equalizer::~Equalizer() {
-  delete BgTask;
-  delete BgImportTask;
+  Prefetch.reset();
+  delete BgCommands;
+  delete BgJobs;
+  delete BgDrainTask;
 }
 
-void Equalizer::BgCopy(std::string From, std::string To) {
-  BgTask->Push(std::move(std::make_tuple(From, To, false)));
+
+/* Probes all disks Prefix0..Prefix255, which exist. Gaps are allowed, ie. a
+ * missing /mnt/video2 doesn't hide /mnt/video3.
+ */
+void Equalizer::InitDisks() {
+  std::lock_guard<std::mutex> lock(Mutex);
+  Disks.reserve(256);
+  Mounts = MountPoints();
+
+  for(int i:DiskNumbers())
+     ProbeDisk(i, true);
+  if (Ssd)
+     ProbeSsd();
+  Publish();
 }
 
-void Equalizer::BgMove(std::string From, std::string To) {
-  BgTask->Push(std::move(std::make_tuple(From, To, true)));
+/* The numbers of all known disks and of all dirs PrefixN in the parent dir of
+ * Prefix; one directory read instead of 256 stat() calls. Needs Mutex locked.
+ */
+std::set<int> Equalizer::DiskNumbers() {
+  std::set<int> result;
+  for(auto disk:Disks)
+     result.insert(disk->Number);
+
+  size_t p = Prefix.rfind('/');
+  std::string dir  = (p == std::string::npos)? "." : (p == 0)? "/" : Prefix.substr(0, p);
+  std::string base = (p == std::string::npos)? Prefix : Prefix.substr(p + 1);
+  DirSnapshot list(dir);
+  for(size_t i = 0; i < list.Count(); i++) {
+     std::string_view name(list.CName(i));
+     if (name.size() <= base.size() or name.size() > base.size() + 3 or name.compare(0, base.size(), base) != 0)
+        continue;
+     std::string_view number = name.substr(base.size());
+     if (number.find_first_not_of("0123456789") != std::string_view::npos)
+        continue;
+     int n = std::atoi(std::string(number).c_str());
+     if (n < 256 and std::to_string(n) == number)
+        result.insert(n);
+     }
+  return result;
 }
 
-void Equalizer::BgImport(std::string videodir, std::string Disk, std::string Src, std::string Dir) {
-  BgImportTask->Push(std::move(std::make_tuple(videodir, Disk, Src, Dir, false)));
+/* Makes the current disks and mapping visible to readers. Needs Mutex locked. */
+void Equalizer::Publish() {
+  auto p = std::make_shared<Placement>();
+  p->DiskSeq   = DiskSeq;
+  p->DiskChars = DiskChars;
+  p->Disks     = Disks;
+  p->Ssd       = Ssd;
+  std::atomic_store(&placement, std::shared_ptr<const Placement>(p));
+  Health::Watch(DiskPaths());
+  if (Prefetch)
+     Prefetch->Watch(DiskPaths());
 }
 
-// ok. 20180127
-void Equalizer::InitDisks() {
-  Disks.reserve(256);
+/* Checks disk 'Number' and updates its state. A disk, which was once found
+ * mounted is offline, as soon as it disappears from the mount table; otherwise
+ * we would write into the empty mount point on the root fs.
+ * Unknown disks are added, sorted by number. Needs Mutex locked.
+ * A disk added while running gets no letters, so that the other disks keep
+ * theirs; it gets letters with the next balance.
+ */
+DiskPtr Equalizer::ProbeDisk(int Number, bool Startup) {
+  std::string d = Prefix + std::to_string(Number);
+  bool exists = DirectoryExists(d);
+  std::string statfile = exists? DiskStatFile(d) : "";
+  auto it = std::find_if(Disks.begin(), Disks.end(),
+               [Number](DiskPtr& di) { return di->Number >= Number; });
+  DiskPtr disk = (it != Disks.end() and (*it)->Number == Number)? *it : nullptr;
+
+  if (!disk) {
+     if (!exists) return nullptr;
+     disk = std::make_shared<DiskInfo>(d, Number, statfile);
+     if (!Startup and DiskChars.size() == Disks.size()) {
+        DiskChars.insert(DiskChars.begin() + (it - Disks.begin()), "");
+        DiskSeq = LettersSequence(DiskChars);
+        }
+     Disks.insert(it, disk);
+     }
+  else if (exists and statfile != disk->StatFile) {
+     /* another device mounted; readers may still use the old one. */
+     DiskPtr n = std::make_shared<DiskInfo>(d, Number, statfile);
+     n->Online   = disk->Online.load();
+     n->Draining = disk->Draining.load();
+     n->Wakeups  = disk->Wakeups;
+     n->Deferred = disk->Deferred;
+     n->DeferredSince = disk->DeferredSince;
+     *it = disk = n;
+     }
+
+  bool mounted = Mounts.count(d) > 0;
+
+  /* an empty mount point on the root fs, ie. the disk isn't mounted yet,
+   * is offline; recordings there would be hidden by the later mount. */
+  disk->SpaceValid = false;
+  bool online = exists and (mounted or IsMountPoint(d)) and disk->GetSpace();
+  if (online != disk->Online)
+     std::cerr << d << (online? ": online" : ": offline") << std::endl;
+  disk->Online = online;
+  return disk;
+}
+
+/* Same as ProbeDisk(), for the optional SSD. Needs Mutex locked. */
+void Equalizer::ProbeSsd() {
+  bool mounted = Mounts.count(Ssd->Path) > 0;
 
-  for(size_t i = 0; i < 256; i++) {
-     std::string d = Prefix + std::to_string(i);
-     if (!DirectoryExists(d)) break;
-     Disks.push_back(new DiskInfo(d));
+  Ssd->SpaceValid = false;
+  bool online = DirectoryExists(Ssd->Path) and (mounted or IsMountPoint(Ssd->Path)) and Ssd->GetSpace();
+  if (online != Ssd->Online)
+     std::cerr << Ssd->Path << (online? ": online" : ": offline") << std::endl;
+  Ssd->Online = online;
+}
+
+/* Re-checks all disks, if the mount table changed.
+ * Returns true, if the set of disks or their state may have changed.
+ */
+bool Equalizer::Rescan() {
+  std::set<std::string> m = MountPoints();
+  std::lock_guard<std::mutex> lock(Mutex);
+  if (m == Mounts)
+     return false;
+
+  Mounts = m;
+  for(int i:DiskNumbers())
+     ProbeDisk(i);
+  if (Ssd)
+     ProbeSsd();
+  Publish();
+  return true;
+}
+
+std::string Equalizer::AddDisk(int Number) {
+  std::lock_guard<std::mutex> lock(Mutex);
+  Mounts = MountPoints();
+  DiskPtr disk = ProbeDisk(Number);
+  Publish();
+  if (!disk)
+     return Prefix + std::to_string(Number) + " not found";
+  disk->Draining = false;
+  disk->Degraded = false;
+  disk->DrainQueued = false;
+  disk->Reason.clear();
+  Health::Reset(disk->Path);
+  return disk->Path + (disk->Online? " online" : " offline");
+}
+
+/* Stops placing new files on disk 'Number' and moves all recordings off
+ * that disk in background. Never waits; Busy is set, if the drain queue is
+ * in use, ie. by the SSD migration, and nothing was changed. */
+std::string Equalizer::DrainDisk(std::string videodir, int Number, bool& Busy) {
+  DiskPtr found;
+  Busy = false;
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    for(auto disk:Disks)
+       if (disk->Number == Number)
+          found = disk;
+  }
+  if (!found)
+     return Prefix + std::to_string(Number) + " not found";
+  bool draining = found->Draining.exchange(true);
+  if (!BgDrainTask->TryPush(std::move(std::make_tuple(videodir, found->Path, (time_t) 0, (size_t) 0)))) {
+     found->Draining = draining;
+     Busy = true;
+     return "drain queue busy, try again later";
      }
-  Disks.shrink_to_fit();
+  return found->Path + " draining";
 }
 
-// ok. 20180127
-void Equalizer::Initialize() {
-  DiskChars.clear();
-  DiskChars.reserve(DiskSeq.size());
+/* Moves recordings from the SSD to their archive disks, once they are older
+ * than SsdMinAge, or the SSD runs short of space. Never waits. */
+void Equalizer::MigrateSsd(std::string videodir) {
+  if (Ssd and Ssd->Online)
+     BgDrainTask->TryPush(std::move(std::make_tuple(videodir, Ssd->Path, (time_t) SsdMinAge, SsdMinFree)));
+}
 
-  for(size_t i = 0; i < DiskSeq.size(); i++) {
-     size_t p1 = alphabet.find(DiskSeq[i]);
-     size_t p2 = (i+1) < DiskSeq.size()? alphabet.find(DiskSeq[i+1]) : 1 + alphabet.find('z');
-     DiskChars.push_back(alphabet.substr(p1, p2 - p1));
+/* Moves files off 'Disk'. Files younger than MinAge are kept, unless the
+ * disks free space is below MinFree; then the oldest files go first.
+ * Draining a disk is MinAge = 0 and MinFree = 0; Relieve() is MinAge = max,
+ * its moves are made for the forecast and may wait for a sleeping target.
+ */
+void Equalizer::DrainWork(DrainData& d) {
+  std::string videodir = std::get<0>(d);
+  std::string Disk     = std::get<1>(d);
+  time_t MinAge        = std::get<2>(d);
+  size_t MinFree       = std::get<3>(d);
+  PathStore Paths;   /* only for this run; deferred jobs keep plain strings. */
+  std::vector<PathStore::Handle> Links;
+  std::vector<std::pair<time_t,PathStore::Handle>> Files;
+  size_t moved = 0, skipped = 0, deferred = 0;
+  size_t pending = 0;   /* bytes of deferred files, still on Disk. */
+  time_t wait = 600;    /* for a replay to end; 0 after the first timeout. */
+  bool relief = MinAge == std::numeric_limits<time_t>::max();
+  DiskInfo info(Disk, -1);
+
+  FindSymlinks(videodir, Disk, Paths, Links);
+  for(auto link:Links)
+     Files.push_back(std::make_pair(FileAge(LinkDest(Paths.Get(link))), link));
+  std::sort(Files.rbegin(), Files.rend());
+
+  for(auto f:Files) {
+     std::string link = Paths.Get(f.second);
+     std::string from = LinkDest(link);
+     std::string dir  = link.substr(0, link.rfind('/'));
+     /* moved already, with another link to the same shared file. */
+     if (from.compare(0, Disk.size() + 1, Disk + '/') != 0)
+        continue;
+     /* files written in the last minutes may belong to a running recording;
+      * vdr writes the index of a recording in progress all the time. */
+     if (f.first < 300 or (FileExists(dir + "/index") and FileAge(dir + "/index") < 300)) {
+        skipped++;
+        continue;
+        }
+     bool pressure = MinFree and info.GetSpace() and info.Free + pending < MinFree;
+     if (f.first < MinAge and !pressure)
+        break;
+     if (MinAge and Pinned(from)) {
+        skipped++;
+        continue;
+        }
+     std::string dest = Target(link, CharMapping(link.substr(videodir.size() + 1)));
+     if (dest.empty() or dest == Disk) {
+        skipped++;
+        continue;
+        }
+     std::string disk(dest);
+     dest += from.substr(from.rfind('/'));
+     if (MinAge and (relief or !pressure) and Defer(disk, link, [this, link, from, dest]() {
+            if (LinkDest(link) == from)
+               Relink(link, from, dest);
+            })) {
+        deferred++;
+        pending += FileSize(from);
+        continue;
+        }
+     if (Relink(link, from, dest, wait))
+        moved++;
+     else
+        skipped++;
      }
+  if (moved or skipped or !MinAge)
+     std::cerr << "drain " << Disk << ": " << moved << " files moved, "
+            << skipped << " skipped, " << deferred << " deferred" << std::endl;
 }
 
-// ok. 20180127
-std::string Equalizer::SplitEqual() {
-  size_t n = Disks.size();
-  size_t d = (0.5 + alphabet.size()) / n;
+/* Called by the Prefetcher: Disk is read by a replay. */
+void Equalizer::Replay(const std::string& Disk) {
+  auto p = Current();
+  time_t until = time(nullptr) + 30;
+  for(auto disk:p->Disks)
+     if (disk->Path == Disk)
+        disk->PlayedUntil = until;
+  if (p->Ssd and p->Ssd->Path == Disk)
+     p->Ssd->PlayedUntil = until;
+}
 
-  DiskChars.clear();
-  DiskChars.reserve(Disks.size());
-  DiskSeq.clear();
+/* true, if the disk holding File is read by a replay. */
+bool Equalizer::Played(std::string_view File) {
+  auto p = Current();
+  std::string_view dir = File.substr(0, File.rfind('/'));
+  time_t now = time(nullptr);
+  for(auto disk:p->Disks)
+     if (disk->Path == dir)
+        return disk->PlayedUntil > now;
+  return p->Ssd and p->Ssd->Path == dir and p->Ssd->PlayedUntil > now;
+}
 
-  for(size_t i = 0; i < n; i++) {
-     std::string s = alphabet.substr(i * d, d);
-     DiskChars.push_back(s);
-     DiskSeq += s[0];
+/* RelinkFile() for background transfers; waits up to Wait seconds while the
+ * source or the target disk is used by a replay, as the copy would cause it
+ * to stall. A replay lasting longer requeues the transfer as deferred job of
+ * the target disk, it is retried from PollPower() then; returns false. Wait
+ * is set to 0 then, so that the rest of a batch is requeued w/o waiting.
+ * A file shared by several links after DEDUP is moved once, with all its
+ * links; it stays, if one of its known links no longer points to it.
+ */
+bool Equalizer::Relink(const std::string& Link, const std::string& From, const std::string& To, time_t& Wait) {
+  time_t deadline = time(nullptr) + Wait;
+  while(Played(From) or Played(To)) {
+     if (time(nullptr) >= deadline) {
+        Defer(To.substr(0, To.rfind('/')), Link, [this, Link, From, To]() {
+           if (LinkDest(Link) == From)
+              Relink(Link, From, To);
+           }, true);
+        Wait = 0;
+        return false;
+        }
+     std::this_thread::sleep_for(std::chrono::seconds(1));
+     }
+  auto links = Shared.Links(From);
+  if (links.empty())
+     return RelinkFile(Link, From, To);
+  char buf[PATH_MAX];
+  for(auto& l:links)
+     if (LinkDest(l, buf, sizeof(buf)) != From)
+        return false;
+  if (!RelinkFile(links, From, To))
+     return false;
+  Shared.Moved(From, To);
+  return true;
+}
+
+/* Non-urgent work for a sleeping disk is kept until the disk wakes up
+ * anyway, or MaxDefer is over. Returns false, if the job is to be done now.
+ * With Always, the job is kept also for an awake disk, ie. to retry it later.
+ * A job with the same Key replaces the older one.
+ */
+bool Equalizer::Defer(std::string Disk, std::string Key, Job j, bool Always) {
+  std::lock_guard<std::mutex> lock(Mutex);
+  for(auto disk:Disks) {
+     if (disk->Path != Disk) continue;
+     if (!Always and !disk->Sleeping(IdleTime)) return false;
+     if (disk->Deferred.empty())
+        disk->DeferredSince = time(nullptr);
+     disk->Deferred[Key] = j;
+     return true;
+     }
+  return false;
+}
+
+/* Called regularly from Housekeeping(). A disk with HealthMaxErrors I/O
+ * errors within the last hour, or with 95% of at least 20 operations slower
+ * than HealthMaxLatency, is degraded: it gets no new recordings and, with
+ * HealthDrain, all its recordings are moved off. After a full hour w/o errors
+ * and w/o slow I/O it's back in service; ADD_DISK does so at once.
+ */
+void Equalizer::CheckHealth(std::string videodir) {
+  std::vector<DiskPtr> drain;
+  time_t now = time(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    std::vector<DiskPtr> disks(Disks);
+    if (Ssd)
+       disks.push_back(Ssd);
+    for(auto disk:disks) {
+       if (!disk->Online)
+          continue;
+       auto s = Health::Get(disk->Path);
+       bool slow = HealthMaxLatency > 0 and s.Ops >= 20 and s.P95 > HealthMaxLatency;
+       if (disk->Degraded) {
+          /* the histogram covers one hour: all of it after the degrade. */
+          if ((now - disk->DegradedSince) >= 3600 and !s.Errors and !slow) {
+             disk->Degraded = false;
+             disk->DrainQueued = false;
+             disk->Reason.clear();
+             std::cerr << disk->Path << " recovered" << std::endl;
+             }
+          /* a drain, which found the queue busy, is tried again. */
+          else if (HealthDrain and disk != Ssd and !disk->DrainQueued)
+             drain.push_back(disk);
+          continue;
+          }
+       std::stringstream reason;
+       if (HealthMaxErrors and s.Errors >= HealthMaxErrors)
+          reason << s.Errors << " I/O errors";
+       else if (slow)
+          reason << "95% of I/O slower than " << s.P95 << "ms";
+       else
+          continue;
+       disk->Reason = reason.str();
+       disk->Degraded = true;
+       disk->DegradedSince = now;
+       std::cerr << disk->Path << " degraded: " << disk->Reason << std::endl;
+       if (HealthDrain and disk != Ssd)
+          drain.push_back(disk);
+       }
+  }
+  for(auto& d:drain)
+     if (BgDrainTask->TryPush(std::move(std::make_tuple(videodir, d->Path, (time_t) 0, (size_t) 0)))) {
+        std::lock_guard<std::mutex> lock(Mutex);
+        d->DrainQueued = true;
+        }
+}
+
+std::string Equalizer::HealthStatus() {
+  std::lock_guard<std::mutex> lock(Mutex);
+  std::vector<DiskPtr> disks(Disks);
+  if (Ssd)
+     disks.push_back(Ssd);
+  std::stringstream ss;
+  for(size_t i = 0; i < disks.size(); i++) {
+     DiskPtr disk = disks[i];
+     auto s = Health::Get(disk->Path);
+     ss << disk->Path << ' ' << (!disk->Online? "offline" : disk->Degraded? "degraded" : "ok")
+        << ", last hour: " << s.Ops << " ops, " << s.Errors << " errors";
+     if (s.Ops)
+        ss << ", p50 " << s.P50 << "ms, p95 " << s.P95 << "ms, max " << std::lround(s.Max) << "ms ["
+           << Health::Text(s) << ']';
+     if (disk->Degraded)
+        ss << ", " << disk->Reason;
+     if ((i+1) < disks.size())
+        ss << '\n';
+     }
+  return ss.str();
+}
+
+/* true, if Disk is one of HotDisks. */
+bool Equalizer::Fast(std::string_view Disk) {
+  if (HotDisks.empty())
+     return false;
+  for(auto disk:Current()->Disks)
+     if (disk->Path == Disk)
+        return HotDisks.count(disk->Number) > 0;
+  return false;
+}
+
+/* true, if File, a file on a disk, belongs to a recording, which was moved
+ * to a fast disk and isn't cold yet; balancing leaves it there. */
+bool Equalizer::Pinned(std::string_view File) {
+  size_t slash = File.rfind('/');
+  if (HotDisks.empty() or slash == std::string_view::npos or !Fast(File.substr(0, slash)))
+     return false;
+  std::string name(File.substr(slash + 1));
+  return Heat.Heat(std::string(Recording(name.c_str())), time(nullptr)) >= HotReplays / 2;
+}
+
+/* Called regularly from Housekeeping(). Counts disk wakeups and starts
+ * deferred jobs of awake disks in one batch.
+ */
+void Equalizer::PollPower() {
+  std::lock_guard<std::mutex> lock(Mutex);
+  time_t now = time(nullptr);
+
+  for(auto disk:Disks) {
+     uint64_t io, ticks;
+     if (disk->StatFile.empty() or !DiskIoCount(disk->StatFile, io, &ticks))
+        continue;
+     if (disk->LastPoll and now > disk->LastPoll)
+        disk->Busy = std::min<uint64_t>(1000, (ticks - disk->IoTicks) / (now - disk->LastPoll));
+     disk->IoTicks = ticks;
+     disk->LastPoll = now;
+     uint64_t errors;
+     if (DiskIoErrors(disk->StatFile, errors)) {
+        if (disk->IoErrors != UINT64_MAX and errors > disk->IoErrors)
+           Health::Errors(disk->Path, errors - disk->IoErrors);
+        disk->IoErrors = errors;
+        }
+     if (io != disk->IoCount) {
+        if (disk->IoCount and (now - disk->LastIo) >= IdleTime)
+           disk->Wakeups++;
+        disk->IoCount = io;
+        disk->LastIo = now;
+        }
+     if (disk->Deferred.empty())
+        continue;
+     if (disk->Sleeping(IdleTime) and (now - disk->DeferredSince) < MaxDefer)
+        continue;
+     std::vector<Job> batch;
+     for(auto& d:disk->Deferred)
+        batch.push_back(d.second);
+     if (BgJobs->TryPush([batch]() { for(auto j:batch) j(); }))
+        disk->Deferred.clear();
      }
+}
+
+/* all disks, which are online, incl. the SSD. */
+std::vector<std::string> Equalizer::DiskPaths() {
+  auto p = Current();
+  std::vector<std::string> result;
+  for(auto disk:p->Disks)
+     if (disk->Online)
+        result.push_back(disk->Path);
+  if (p->Ssd and p->Ssd->Online)
+     result.push_back(p->Ssd->Path);
+  return result;
+}
+
+void Equalizer::DiskList(std::vector<Vdirs_DiskInfo_v1_0::Disk>& Result) {
+  auto p = Current();
+  std::vector<DiskPtr> all(p->Disks);
+  if (p->Ssd)
+     all.push_back(p->Ssd);
+
+  Result.clear();
+  for(auto disk:all) {
+     Vdirs_DiskInfo_v1_0::Disk d;
+     if (disk->Online) disk->GetSpace();
+     d.Path     = disk->Path;
+     d.Number   = disk->Number;
+     d.FreeMB   = disk->Free / mebibyte;
+     d.UsedMB   = disk->Used / mebibyte;
+     d.Online   = disk->Online;
+     d.ReadOnly = disk->ReadOnly;
+     d.Draining = disk->Draining;
+     Result.push_back(d);
+     }
+}
+
+size_t Equalizer::Queued() {
+  return BgDrainTask->Size() + BgJobs->Size() + BgCommands->Size();
+}
+
+size_t Equalizer::DeferredJobs() {
+  std::lock_guard<std::mutex> lock(Mutex);
+  size_t n = 0;
+  for(auto disk:Disks)
+     n += disk->Deferred.size();
+  return n;
+}
+
+std::string Equalizer::DiskStatus() {
+  std::lock_guard<std::mutex> lock(Mutex);
+  std::stringstream ss;
+  for(size_t i = 0; i < Disks.size(); i++) {
+     DiskPtr disk = Disks[i];
+     if (disk->Online) disk->GetSpace();
+     ss << disk->Path << ' ';
+     if      (!disk->Online)  ss << "offline";
+     else if (disk->ReadOnly) ss << "readonly";
+     else if (disk->Degraded) ss << "degraded";
+     else if (disk->Draining) ss << "draining";
+     else                     ss << "online";
+     ss << ' ' << (disk->Free / mebibyte) << "MB free";
+     if (disk->PlayedUntil > time(nullptr))
+        ss << ", replay";
+     if (!disk->StatFile.empty())
+        ss << ", " << (disk->Sleeping(IdleTime)? "idle" : "active") << ", "
+           << disk->Wakeups << " wakeups, " << disk->Deferred.size() << " deferred";
+     if (i < DiskChars.size())
+        ss << " '" << DiskChars[i] << "'";
+     if ((i+1) < Disks.size())
+        ss << '\n';
+     }
+  return ss.str();
+}
+
+/* Called hourly. Only reads cached disk space, so sleeping disks stay asleep. */
+void Equalizer::SampleGrowth() {
+  auto p = Current();
+  time_t now = time(nullptr);
+  for(size_t i = 0; i < p->Disks.size(); i++) {
+     DiskPtr disk = p->Disks[i];
+     if (!disk->Online or !disk->SpaceValid)
+        continue;
+     Growth.Sample(disk->Path, i < p->DiskChars.size()? p->DiskChars[i] : "", disk->Used, now);
+     }
+}
+
+/* true, if the local time is within [BalanceFrom, BalanceTo). */
+bool Equalizer::BalanceTime() {
+  time_t now = time(nullptr);
+  struct tm t;
+  localtime_r(&now, &t);
+  if (BalanceFrom <= BalanceTo)
+     return t.tm_hour >= BalanceFrom and t.tm_hour < BalanceTo;
+  return t.tm_hour >= BalanceFrom or t.tm_hour < BalanceTo;
+}
+
+/* Disks, which are expected to drop below MinFree within Horizon. */
+std::vector<std::string> Equalizer::RunningShort() {
+  std::vector<std::string> result;
+  for(auto disk:Current()->Disks) {
+     if (!disk->Writable() or !disk->SpaceValid)
+        continue;
+     time_t t = Growth.TimeToFull(disk->Path, disk->Free, MinFree);
+     if (t >= 0 and t < Horizon)
+        result.push_back(disk->Path);
+     }
+  return result;
+}
+
+/* Moves files, which are no longer mapped to Disk, off that disk; until Disk
+ * has room for the growth expected within Horizon. At most a tenth of the
+ * disk per call, the rest is left for the next night.
+ * Returns false, if the drain queue is busy and nothing was queued.
+ */
+bool Equalizer::Relieve(std::string videodir, std::string Disk) {
+  for(auto disk:Current()->Disks) {
+     if (disk->Path != Disk or !disk->GetSpace())
+        continue;
+     double rate = std::max(0.0, Growth.Rate(Disk));
+     size_t target = MinFree + rate * Horizon;
+     target = std::min(target, disk->Free + disk->Total / 10);
+     if (target > disk->Free)
+        return BgDrainTask->TryPush(std::move(std::make_tuple(videodir, Disk,
+           std::numeric_limits<time_t>::max(), target)));
+     }
+  return true;
+}
+
+std::string Equalizer::ForecastStatus() {
+  auto p = Current();
+  std::stringstream ss;
+  for(size_t i = 0; i < p->Disks.size(); i++) {
+     DiskPtr disk = p->Disks[i];
+     double rate = Growth.Rate(disk->Path);
+     ss << disk->Path << ' ' << (disk->Free / mebibyte) << "MB free, "
+        << std::lround(rate * 86400 / mebibyte) << "MB/day, ";
+     time_t t = Growth.TimeToFull(disk->Path, disk->Free, MinFree);
+     if (t < 0)
+        ss << "not growing";
+     else
+        ss << "below " << (MinFree / gibibyte) << "GB in " << std::lround(t / 3600.0) << "h";
+     if (i < p->DiskChars.size()) {
+        ss << " '";
+        for(char c:p->DiskChars[i])
+           ss << c << ':' << std::lround(Growth.CharRate(c) * 86400 / mebibyte) << ' ';
+        ss << "MB/day'";
+        }
+     if ((i+1) < p->Disks.size())
+        ss << '\n';
+     }
+  return ss.str();
+}
+
+/* Moves recordings replayed at least HotReplays times (within about a half
+ * life) to the fast disk with most free space, and recordings on a fast disk,
+ * which cooled down to less than half of that, back to the disk of their
+ * first letter. Cold ones first, as they make room; then the hottest. Stops
+ * at the move budget, which refills by HotBudget per day. Striped recordings
+ * stay where they are.
+ */
+void Equalizer::MoveHot(std::string videodir, JobInfo& job) {
+  if (HotDisks.empty())
+     return;
+  auto p = Current();
+  time_t now = time(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    HotAllowance = std::min<double>(HotBudget, HotAllowance + (double) HotBudget * (now - HotRefill) / 86400);
+    HotRefill = now;
+  }
+
+  std::vector<DiskPtr> online;
+  std::vector<std::string> Roots;
+  std::map<std::string, double> free;
+  for(auto disk:p->Disks) {
+     if (!disk->Online or !disk->GetSpace()) continue;
+     online.push_back(disk);
+     Roots.push_back(disk->Path);
+     free[disk->Path] = disk->Free;
+     }
+
+  struct Rec {
+     size_t Disk;
+     size_t Size = 0;
+     bool Striped = false;
+     std::vector<std::string> Files;
+     };
+  std::map<std::string, Rec> recs;
+  auto Scans = ScanDirs(Roots, false, true);
+  for(size_t d = 0; d < Scans.size(); d++)
+     for(size_t i = 0; i < Scans[d].Count(); i++) {
+        std::string name(Recording(Scans[d].CName(i)));
+        if (name.empty()) continue;
+        auto r = recs.emplace(name, Rec{d, 0, false, {}});
+        Rec& rec = r.first->second;
+        rec.Striped |= rec.Disk != d;
+        rec.Size += Scans[d].Size(i);
+        rec.Files.push_back(Scans[d].CName(i));
+        }
+
+  /* recording -> new disk. */
+  std::vector<std::pair<std::string, std::string>> moves;
+  for(auto& r:recs) {
+     DiskPtr disk = online[r.second.Disk];
+     if (r.second.Striped or !HotDisks.count(disk->Number) or Heat.Heat(r.first, now) >= HotReplays / 2)
+        continue;
+     std::string home = Storage(CharMapping(r.first));
+     if (home.empty() or home == disk->Path or free[home] < MinFree + r.second.Size)
+        continue;
+     free[home] -= r.second.Size;
+     free[disk->Path] += r.second.Size;
+     moves.push_back(std::make_pair(r.first, home));
+     }
+  for(auto& h:Heat.Ranking(now)) {
+     if (h.first < HotReplays)
+        break;
+     auto it = recs.find(h.second);
+     if (it == recs.end() or it->second.Striped or HotDisks.count(online[it->second.Disk]->Number))
+        continue;
+     DiskPtr best;
+     for(auto disk:online)
+        if (HotDisks.count(disk->Number) and disk->Writable() and
+            free[disk->Path] >= MinFree + it->second.Size and (!best or free[disk->Path] > free[best->Path]))
+           best = disk;
+     if (!best)
+        break;
+     free[best->Path] -= it->second.Size;
+     moves.push_back(std::make_pair(h.second, best->Path));
+     }
+
+  /* the links of the disks involved; one walk of videodir per disk. */
+  PathStore Paths;
+  std::map<std::string, PathStore::Handle> links;
+  std::set<std::string> walked;
+  size_t moved = 0;
+  time_t wait = 600;    /* for a replay to end; 0 after the first timeout. */
+  for(auto& m:moves) {
+     if (job.Cancelled())
+        break;
+     Rec& rec = recs[m.first];
+     std::string from = online[rec.Disk]->Path;
+     {
+       std::lock_guard<std::mutex> lock(Mutex);
+       if (HotAllowance < rec.Size) {
+          job.Print("move budget used up");
+          break;
+          }
+     }
+     if (walked.insert(from).second) {
+        std::vector<PathStore::Handle> found;
+        FindSymlinks(videodir, from, Paths, found);
+        for(auto h:found)
+           links[LinkDest(Paths.Get(h))] = h;
+        }
+     job.Print(m.first + ": " + from + " -> " + m.second);
+     size_t bytes = 0;
+     for(auto& f:rec.Files) {
+        auto l = links.find(from + '/' + f);
+        if (l != links.end() and Relink(Paths.Get(l->second), l->first, m.second + '/' + f, wait))
+           bytes += FileSize(m.second + '/' + f);
+        }
+     /* only what was moved is charged; skipped files cost nothing. */
+     std::lock_guard<std::mutex> lock(Mutex);
+     HotAllowance -= bytes;
+     moved += bytes;
+     }
+  if (!moves.empty())
+     std::cerr << "hot: " << (moved / mebibyte) << "MB moved" << std::endl;
+}
+
+std::string Equalizer::HeatStatus() {
+  if (HotDisks.empty())
+     return "no HotDisks set";
+  std::stringstream ss;
+  time_t now = time(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    double allowance = std::min<double>(HotBudget, HotAllowance + (double) HotBudget * (now - HotRefill) / 86400);
+    ss << "move budget left: " << std::lround(allowance / mebibyte) << "MB of "
+       << (HotBudget / gibibyte) << "GB/day";
+  }
+  auto ranking = Heat.Ranking(now);
+  for(size_t i = 0; i < ranking.size() and i < 20; i++)
+     ss << '\n' << std::fixed << std::setprecision(1) << ranking[i].first
+        << (ranking[i].first >= HotReplays? " hot  " : "      ") << ranking[i].second;
+  return ss.str();
+}
+
+// ok. 20180127
+void Equalizer::Initialize() {
+  DiskChars = SequenceLetters(DiskSeq);
+}
+
+// ok. 20180127
+std::string Equalizer::SplitEqual() {
+  std::lock_guard<std::mutex> lock(Mutex);
+  if (Disks.empty()) return DiskSeq;
+
+  DiskChars = SplitLetters(Disks.size());
+  DiskSeq = LettersSequence(DiskChars);
+  Publish();
   return DiskSeq;
 }
 
 // ok. 20180127
 void Equalizer::DiskSpace(size_t& Free, size_t& Used) {
+  auto p = Current();
   Free = 0;
   Used = 0;
 
-  for(auto disk:Disks) {
-     if (!disk->GetSpace()) break;
+  for(auto disk:p->Disks) {
+     if (!disk->Writable() or !disk->GetSpace()) continue;
      Free += disk->Free;
      Used += disk->Used;
      }
 }
 
-// ok. 20180127
+/* Returns the disk for a recording starting with 'c'. If that disk isn't
+ * writable, the writable disk with most free space, or an empty string if
+ * there is none at all.
+ */
 std::string  Equalizer::Storage(char c) {
-  for(size_t i = 0; i < DiskChars.size(); i++)
-     if (DiskChars[i].find(c) != std::string::npos) return Disks[i]->Path;
-  return Disks[0]->Path;
+  auto p = Current();
+  for(size_t i = 0; i < p->DiskChars.size() and i < p->Disks.size(); i++)
+     if (p->DiskChars[i].find(c) != std::string::npos) {
+        if (p->Disks[i]->Writable()) return p->Disks[i]->Path;
+        break;
+        }
+
+  DiskPtr best;
+  for(auto disk:p->Disks)
+     if (disk->Writable() and disk->GetSpace() and (!best or disk->Free > best->Free))
+        best = disk;
+  return best? best->Path : "";
 }
 
-// ok. 20180127
-char Equalizer::CharMapping(std::string s) {
-  if (s.size() < 1) return '0';
-  const char* c = s.c_str(), *p = c;
-
-  if (*p == '/') { if (s.size() < 2) return '0'; p++; }
-  if (*p == '%') { if (s.size() < 2) return '0'; p++; }
-
-  switch((unsigned char)*p) {
-     case 0x00: return '0';
-     case 0xC2: return CharMapping(p+2);
-     case 0xC3:
-         switch((unsigned char)*++p) {
-            case 0xA0 ... 0xA6: return 'a';
-            case 0x80 ... 0x86: return 'a';
-            case 0xA7:          return 'c';
-            case 0x87:          return 'c';
-            case 0xA8 ... 0xAB: return 'e';
-            case 0x88 ... 0x8B: return 'e';
-            case 0xAC ... 0xAF: return 'i';
-            case 0x8C ... 0x8F: return 'i';
-            case 0xB0:          return 'd';
-            case 0x90:          return 'd';
-            case 0xB1:          return 'n';
-            case 0x91:          return 'n';
-            case 0xB2 ... 0xB6: return 'o';
-            case 0x92 ... 0x96: return 'o';
-            case 0xB7:          return CharMapping(p+2);
-            case 0x97:          return CharMapping(p+2);
-            case 0xB8:          return 'o';
-            case 0x98:          return 'o';
-            case 0xB9 ... 0xBC: return 'u';
-            case 0x99 ... 0x9C: return 'u';
-            case 0xBD:          return 'y';
-            case 0x9D:          return 'y';
-            case 0xBE:          return 't';
-            case 0x9E:          return 't';
-            case 0x9F:          return 's';
-            case 0xBF:          return 'y';
-            }
-     case 0xC4 ... 0xDF: return CharMapping(p+2);
-     case 0xE0 ... 0xEF: return CharMapping(p+3);
-     case 0xF0 ... 0xF4: return CharMapping(p+4);
-     case '0' ... '9': return *p;
-     case 'a' ... 'z': return *p;
-     case 'A' ... 'Z': return *p + 32;
-     default: return CharMapping(++p);
-     }
-  return '0'; /* never reached. */
-}
-
-void Equalizer::Add(std::string Path) {
+/* Striped recordings are spread over all disks and don't belong to their
+ * first letter; their size is returned in StripedUse instead. */
+void Equalizer::Add(const DirSnapshot& Files, size_t* DiskUsePerChar, const std::set<std::string_view>& Stripes, size_t& StripedUse) {
   uint8_t MappedChar;
-  for(auto f:cFileList(Path).List()) {
-     MappedChar = (uint8_t) CharMapping(f);
-     DiskUsePerChar[MappedChar] += FileSize(f);
+  for(size_t i = 0; i < Files.Count(); i++) {
+     if (Stripes.count(Recording(Files.CName(i)))) {
+        StripedUse += Files.Size(i);
+        continue;
+        }
+     MappedChar = (uint8_t) CharMapping(Files.CName(i));
+     DiskUsePerChar[MappedChar] += Files.Size(i);
      }
 }
 
-void Equalizer::Equalize(bool forced) {
+/* Scans the disks w/o locking; the new mapping is published at the end, so
+ * Register() continues to use the old one until then.
+ */
+void Equalizer::Equalize(JobInfo& job, bool forced) {
+  auto p = Current();
   bool RunningShort = forced;
-  double Goal = 0;
-  Reset();
-  for(auto disk:Disks) {
-     disk->GetSpace();
-     Goal += disk->Free;
-     Add(disk->Path);
-     if (disk->Free < 100*gibibyte)
+  std::vector<std::string> Roots;
+  size_t DiskUsePerChar[256] = { 0 };
+
+  Metrics::Add(Metrics::BalanceRuns);
+  for(auto disk:p->Disks) {
+     if (!disk->Online or !disk->GetSpace()) continue;
+     Roots.push_back(disk->Path);
+     if (disk->Free < MinFree)
         RunningShort = true;
      }
-  if (!RunningShort) return;
-  Goal /= Disks.size();
-
-  DiskSeq.clear();
-  DiskChars.clear();
-  std::string letters;
-  letters.reserve(alphabet.size());
-  size_t last = std::string::npos;
-
-  for(auto disk:Disks) {
-     double left = disk->Total;
-     for(char c:alphabet) {
-        uint8_t u = (uint8_t) c;
-        if (last != std::string::npos and u <= last)
-           continue;
-
-        double CharUse = DiskUsePerChar[u];
-        std::cerr << "char " << c << ":" << CharUse << std::endl;
-
-        if (left < CharUse)
-           break;
-        if (left >= Goal or !letters.size()) {
-           letters += c;
-           left -= CharUse;
-           last = u;
-           }
-        else {
-           if (c != 'z' and left > DiskUsePerChar[u+1]) {
-              double delta  = std::abs(left - Goal);
-              double delta2 = std::abs(left - Goal - DiskUsePerChar[u+1]);
-              if (delta2 < delta) {
-                 CharUse = DiskUsePerChar[++u];
-                 letters += alphabet[alphabet.find(c) + 1];
-                 left -= CharUse;
-                 last = u;
-                 }
-              }
-           break;
-           }
+  /* recordings found on more than one disk are striped. */
+  auto Scans = ScanDirs(Roots, false, true);
+  std::map<std::string_view, size_t> Home;
+  std::set<std::string_view> Stripes;
+  std::map<std::string, size_t> StripedUse;
+  for(size_t d = 0; d < Scans.size(); d++)
+     for(size_t i = 0; i < Scans[d].Count(); i++) {
+        auto name = Recording(Scans[d].CName(i));
+        if (name.empty()) continue; /* no recording, ie. lost+found */
+        auto r = Home.emplace(name, d);
+        if (!r.second and r.first->second != d)
+           Stripes.insert(r.first->first);
         }
-     if (letters.size()) {
-        DiskSeq.push_back(letters[0]);
-        DiskChars.push_back(letters);
-        letters.clear();
-        }
-     else
-        std::cerr << __PRETTY_FUNCTION__ << ": hmm.. letters.size() == 0" << std::endl;
-     std::cerr << disk->Path << ": " << DiskSeq.back() << std::endl;
+  /* hot recordings on a fast disk don't belong to their letter either. */
+  for(auto& h:Home)
+     if (Pinned(Roots[h.second] + '/' + std::string(h.first)))
+        Stripes.insert(h.first);
+  for(size_t d = 0; d < Scans.size(); d++)
+     Add(Scans[d], DiskUsePerChar, Stripes, StripedUse[Roots[d]]);
+  if (!RunningShort or Roots.empty()) {
+     job.Print("no disk below " + std::to_string(MinFree / gibibyte) + "GB, mapping unchanged");
+     return;
      }
+  if (job.Cancelled())
+     return;
+
+  std::vector<DiskLoad> Loads;
+  for(auto disk:p->Disks)
+     Loads.push_back({ (double) disk->Total, (double) disk->Free, (double) StripedUse[disk->Path],
+                       disk->Online and disk->SpaceValid and !disk->Degraded });
+  std::vector<std::string> DiskChars = BalanceLetters(Loads, DiskUsePerChar);
+  if (DiskChars.size() != p->Disks.size())
+     return;
+
+  std::string DiskSeq = LettersSequence(DiskChars);
+  for(size_t i = 0; i < DiskChars.size(); i++)
+     job.Print(p->Disks[i]->Path + ": " + (DiskChars[i].empty()? "-" : DiskChars[i]));
+
+  /* the letters belong to the disks of the snapshot; a Rescan(), ADD_DISK or
+   * another balance may have changed them meanwhile. */
+  std::lock_guard<std::mutex> lock(Mutex);
+  if (Disks != p->Disks) {
+     job.Print("disks changed while balancing, mapping discarded");
+     return;
+     }
+  this->DiskSeq   = DiskSeq;
+  this->DiskChars = DiskChars;
+  Publish();
 }
 
 
@@ -307,12 +1193,63 @@ void Equalizer::Equalize(bool forced) {
  * class MultiVideoDir
  * The actual implementation of multiple video dirs.
  ******************************************************************************/
-MultiVideoDir::MultiVideoDir(std::string Prefix, std::string Seq, bool Balancing) :
-   videodir(cVideoDirectory::Name()), mountprefix(Prefix), balance(Balancing), debug(false) {
-
-  eq = new Equalizer(Prefix, Seq);
-  if (!eq->ValidSequence())
+MultiVideoDir::MultiVideoDir(const VdirsSetup& Setup) :
+   videodir(cVideoDirectory::Name()), mountprefix(Setup.MountPrefix), ssd(Setup.Ssd),
+   balance(Setup.Balance), debug(false), lastscan(0), lastmigration(0),
+   metricsfile(Setup.MetricsFile), metricsinterval(Setup.MetricsInterval), lastmetrics(0),
+   diskseq(Setup.DiskSeq), lastforecast(0), cleanedup(false),
+   movelog(videodir + "/.vdirs-move.log"), movepending(videodir + "/.vdirs-move.pending"), heatfile(videodir + "/.vdirs-heat") {
+
+  auto t = std::chrono::steady_clock::now();
+  auto lap = [this, &t](const char* Step) {
+     auto now = std::chrono::steady_clock::now();
+     startup.push_back(std::make_pair(Step, std::chrono::duration<double, std::milli>(now - t).count()));
+     t = now;
+     };
+
+  eq = new Equalizer(Setup);
+  lap("equalizer");
+  if (!eq->ValidSequence()) {
      SetupStore("DiskSeq", eq->SplitEqual().c_str());
+     lap("split");
+     }
+  RecoverMove();
+  RecoverPending();
+  lap("recover move");
+  eq->LoadHeat(heatfile);
+  eq->Shared.Load(videodir + "/.vdirs-shared");
+
+  if (!Setup.MetricsSocket.empty()) {
+     metricssocket.reset(new MetricsSocket(Setup.MetricsSocket, [this]() { return MetricsText(); }));
+     lap("metrics socket");
+     }
+}
+
+/* Time spent in the constructors and the worker threads right now. */
+std::string MultiVideoDir::StartupStatus() {
+  std::stringstream ss;
+  double total = 0;
+  auto line = [&ss, &total](const std::string& Step, double ms, bool Sum) {
+     ss << std::left << std::setw(20) << Step << std::right << std::fixed
+        << std::setprecision(1) << std::setw(10) << ms << " ms" << std::endl;
+     if (Sum) total += ms;
+     };
+
+  for(auto& s:startup) {
+     line(s.first, s.second, true);
+     if (s.first == "equalizer")
+        for(auto& e:eq->Startup)
+           line("  " + e.first, e.second, false);
+     }
+  ss << std::left << std::setw(20) << "total" << std::right << std::fixed
+     << std::setprecision(1) << std::setw(10) << total << " ms" << std::endl;
+  ss << eq->PoolStatus();
+  return ss.str();
+}
+
+MultiVideoDir::~MultiVideoDir() {
+  metricssocket.reset();
+  eq->SaveHeat(heatfile);
 }
 
 
@@ -334,65 +1271,460 @@ const char** MultiVideoDir::SVDRPHelpPages() {
     "IMPORT_ONE_DRYRUN <PATH>\n"
     "    wie IMPORT_ONE, aber es werden nur die betreffenden Meldungen aus-\n"
     "    gegeben und keine Veraenderungen am Dateisystem vorgenommen.",
+    "DISKS\n"
+    "    Zeigt Zustand, freien Platz und Buchstaben aller Disk Partitionen.",
+    "ADD_DISK <N>\n"
+    "    Nimmt die Disk Partition N (zB. /mnt/video3 fuer N = 3) neu oder\n"
+    "    wieder in Betrieb, ohne vdr neu zu starten.",
+    "DRAIN_DISK <N>\n"
+    "    Keine neuen Aufnahmen mehr auf Disk Partition N; alle Aufnahmen\n"
+    "    werden im Hintergrund auf die anderen Partitionen verschoben.\n"
+    "    Danach kann die Disk entfernt werden.",
+    "FORECAST\n"
+    "    Zeigt je Disk Partition das Wachstum pro Tag, die voraussichtliche\n"
+    "    Zeit bis zum Unterschreiten von BalanceMinFree und das Wachstum je\n"
+    "    Anfangsbuchstabe.",
+    "HEAT\n"
+    "    Zeigt die am haeufigsten wiedergegebenen Aufnahmen und das noch\n"
+    "    verfuegbare Tagesbudget fuer das Verschieben auf die HotDisks.",
+    "HEALTH\n"
+    "    Zeigt je Disk Partition Anzahl, Fehler und Dauer der Zugriffe der\n"
+    "    letzten Stunde. Eine Partition mit zu vielen Fehlern oder zu langsamen\n"
+    "    Zugriffen bekommt keine neuen Aufnahmen mehr und wird geleert; ADD_DISK\n"
+    "    nimmt sie wieder in Betrieb.",
+    "STARTUP\n"
+    "    Zeigt die Dauer der einzelnen Schritte beim Start des Plugins und\n"
+    "    die Anzahl der momentan laufenden Hintergrund Threads.",
+    "VERIFY\n"
+    "    Prueft im Hintergrund alle Links im Video Ordner und meldet Links\n"
+    "    ohne Ziel, sowie Dateien auf den Disks, auf die kein Link zeigt.",
+    "DEDUP [COLLAPSE]\n"
+    "    Sucht im Hintergrund nach Videodateien mit gleichem Inhalt auf den\n"
+    "    Disks und zeigt den dadurch belegten Platz. Mit COLLAPSE bleibt je\n"
+    "    Inhalt nur eine Datei, auf die alle Links zeigen; sie wird erst mit\n"
+    "    dem letzten Link geloescht.",
+    "JOB [<ID>]\n"
+    "    Zeigt Zustand und Ausgaben eines Hintergrund Auftrags, ohne ID eine\n"
+    "    Liste aller Auftraege. BALANCE, VERIFY und IMPORT_ONE antworten\n"
+    "    sofort mit der ID ihres Auftrags.",
+    "CANCEL <ID>\n"
+    "    Bricht einen Hintergrund Auftrag ab.",
     NULL
     };
   return HelpPages;
 }
 
-const char* MultiVideoDir::SVDRPCommand(std::string Command, std::string Option, int& ReplyCode) {
-  static char b[2048];
+/* Long running commands are started as background job; their reply is the
+ * job id only, progress and results are queried by JOB <id>.
+ * Returns false on unknown commands.
+ */
+bool MultiVideoDir::SVDRPCommand(std::string Command, std::string Option, int& ReplyCode, std::string& Reply) {
   ReplyCode = 900;
 
   if (Command == "BALANCE") {
-     Balance();
-     return "BALANCE";
+     StartJob(Command, [this](JobInfo& job) { Balance(job); }, ReplyCode, Reply);
      }
-  else if (Command == "REGISTER")   {
-     if (Option.size() == 0) return "missing arg";
-     Register(Option);
-     return "REGISTER";
+  else if (Command == "VERIFY") {
+     StartJob(Command, [this](JobInfo& job) { Verify(job); }, ReplyCode, Reply);
+     }
+  else if (Command == "DEDUP") {
+     bool collapse = Option == "COLLAPSE";
+     if (!Option.empty() and !collapse) {
+        ReplyCode = 501;
+        Reply = "unknown option " + Option;
+        }
+     else
+        StartJob(collapse? "DEDUP COLLAPSE" : "DEDUP",
+                 [this, collapse](JobInfo& job) { Deduplicate(job, collapse); }, ReplyCode, Reply);
      }
-  else if (Command == "IMPORT_ONE") {
-     if (Option.size() == 0) return "missing arg";
-     Import(Option, true, false);
-     return "IMPORT_ONE";
+  else if (Command == "REGISTER")   {
+     if (Option.size() == 0) Reply = "missing arg";
+     else {
+        Register(Option);
+        Reply = "REGISTER";
+        }
      }
-  else if (Command == "IMPORT_ONE_DRYRUN") {
-     if (Option.size() == 0) return "missing arg";
-     Import(Option, true, true);
-     return "IMPORT_ONE_DRYRUN";
+  else if (Command == "IMPORT_ONE" or Command == "IMPORT_ONE_DRYRUN") {
+     if (Option.size() == 0) Reply = "missing arg";
+     else {
+        bool DryRun = Command == "IMPORT_ONE_DRYRUN";
+        StartJob(Command + ' ' + Option,
+                 [this, Option, DryRun](JobInfo& job) { Import(job, Option, true, DryRun); },
+                 ReplyCode, Reply);
+        }
      }
   else if (Command == "IMPORT_NEXT") {
-     if (Option.size() == 0) return "missing arg";
-     *b = 0;
-     for(auto e:cFileList(Option).List()) {
-        std::string n(Option + "/" + e);
-        if (IsDirectory(n)) {
-           strcpy(b, n.c_str());
+     if (Option.size() == 0) {
+        Reply = "missing arg";
+        return true;
+        }
+     DirSnapshot list(Option);
+     for(size_t i = 0; i < list.Count(); i++) {
+        if (list.IsDirectory(i)) {
+           Reply = list.Path(i);
            break;
            }
         }
-     return b;
      }
-  else if (Command == "DEBUG") {
-     if (debug) {
-        debug = false;
-        return "DEBUG=OFF";
+  else if (Command == "JOB" or Command == "CANCEL") {
+     if (Option.size() == 0) {
+        Reply = jobs.List();
+        return true;
+        }
+     auto job = jobs.Get(std::atoi(Option.c_str()));
+     if (!job) {
+        ReplyCode = 501;
+        Reply = "no such job: " + Option;
         }
      else {
-        debug = true;
-        return "DEBUG=ON";
+        if (Command == "CANCEL")
+           job->Cancel();
+        Reply = job->Status(Command == "JOB");
+        }
+     }
+  else if (Command == "DISKS") {
+     Reply = eq->DiskStatus();
+     }
+  else if (Command == "ADD_DISK" or Command == "DRAIN_DISK") {
+     if (Option.size() == 0) {
+        Reply = "missing arg";
+        return true;
+        }
+     int n = std::atoi(Option.c_str());
+     if (n < 0 or n > 255 or Option.find_first_not_of("0123456789") != std::string::npos) {
+        ReplyCode = 501;
+        Reply = "invalid disk number";
+        }
+     else if (Command == "ADD_DISK") {
+        /* a new DiskSeq is stored by Housekeeping(), in vdrs main thread. */
+        Reply = eq->AddDisk(n);
+        if (!eq->ValidSequence())
+           eq->SplitEqual();
         }
+     else {
+        bool busy;
+        Reply = eq->DrainDisk(videodir, n, busy);
+        if (busy)
+           ReplyCode = 451;
+        }
+     }
+  else if (Command == "FORECAST") {
+     Reply = eq->ForecastStatus();
+     }
+  else if (Command == "HEAT") {
+     Reply = eq->HeatStatus();
+     }
+  else if (Command == "HEALTH") {
+     Reply = eq->HealthStatus();
      }
+  else if (Command == "STARTUP") {
+     Reply = StartupStatus();
+     }
+  else if (Command == "DEBUG") {
+     debug = !debug;
+     Reply = debug? "DEBUG=ON" : "DEBUG=OFF";
+     }
+  else
+     return false;
+  return true;
+}
+
+/* Runs Work in background. Work should check job.Cancelled() from time to
+ * time; its output goes to job.Print().
+ */
+void MultiVideoDir::StartJob(std::string Command, std::function<void(JobInfo&)> Work, int& ReplyCode, std::string& Reply) {
+  auto job = jobs.New(Command);
+  bool started = eq->Background([job, Work]() {
+     if (!job->Cancelled())
+        Work(*job);
+     job->Finish();
+     });
+
+  if (started)
+     Reply = "job " + std::to_string(job->Id) + " started: " + Command;
+  else {
+     job->Cancel();
+     job->Finish();
+     ReplyCode = 451;
+     Reply = "too many jobs running, try again later";
+     }
+}
 
-  return NULL;
+/* Service interface for other plugins, see services.h */
+bool MultiVideoDir::Service(const char* Id, void* Data) {
+  std::string id(Id? Id : "");
+
+  if (id == "Vdirs-DiskInfo-v1.0") {
+     if (Data)
+        eq->DiskList(((Vdirs_DiskInfo_v1_0*) Data)->Disks);
+     return true;
+     }
+  else if (id == "Vdirs-RecordingDisk-v1.0") {
+     if (Data) {
+        auto r = (Vdirs_RecordingDisk_v1_0*) Data;
+        std::string dir(r->Name);
+        bool inside = dir.compare(0, videodir.size(), videodir) == 0 and
+                      (dir.size() == videodir.size() or dir[videodir.size()] == '/');
+        if (!inside)
+           dir = videodir + '/' + dir;
+        std::map<std::string, size_t> count;
+        char buf[PATH_MAX];
+        DirSnapshot list(dir);
+        for(size_t i = 0; i < list.Count(); i++) {
+           if (!list.IsSymlink(i) or !IsVideoFile(list.CName(i))) continue;
+           std::string_view dest = LinkDest(list.Path(i), buf, sizeof(buf));
+           count[std::string(dest.substr(0, dest.rfind('/')))]++;
+           }
+        r->Exists = !count.empty();
+        r->Disks.clear();
+        r->Disk.clear();
+        size_t most = 0;
+        for(auto& c:count) {
+           r->Disks.push_back(c.first);
+           if (c.second > most) {
+              most = c.second;
+              r->Disk = c.first;
+              }
+           }
+        if (!r->Exists)
+           r->Disk = eq->Storage(eq->CharMapping(dir.size() > videodir.size() + 1?
+                                                 dir.substr(videodir.size() + 1) : ""));
+        }
+     return true;
+     }
+  else if (id == "Vdirs-QueueStatus-v1.0") {
+     if (Data) {
+        auto q = (Vdirs_QueueStatus_v1_0*) Data;
+        q->Jobs     = jobs.Running();
+        q->Queued   = eq->Queued();
+        q->Deferred = eq->DeferredJobs();
+        }
+     return true;
+     }
+  else if (id == "Vdirs-TimerFits-v1.0") {
+     if (Data) {
+        auto t = (Vdirs_TimerFits_v1_0*) Data;
+        /* the disk Register() would write the first file to. */
+        t->Disk = eq->Landing(t->Name, eq->CharMapping(t->Name));
+        t->FreeMB = 0;
+        if (!t->Disk.empty()) {
+           std::vector<Vdirs_DiskInfo_v1_0::Disk> disks;
+           eq->DiskList(disks);
+           for(auto& d:disks)
+              if (d.Path == t->Disk)
+                 t->FreeMB = d.FreeMB;
+           }
+        t->Fits = !t->Disk.empty() and t->FreeMB >= t->SizeMB;
+        }
+     return true;
+     }
+  return false;
 }
 
+/* Only from vdrs main thread, ie. Housekeeping(); diskseq is not locked. */
 void MultiVideoDir::SetupStore(const char* Name, const char* Value) {
+  if (std::string(Name) == "DiskSeq")
+     diskseq = Value;
   PluginVdirs->SetupStore(Name, Value);
 }
 
 
+/* Returns the disk, where a new file of a recording starting with 'c' is
+ * written to: the SSD, if there is one with enough space left.
+ */
+std::string Equalizer::Landing(std::string_view File, char c) {
+  if (Ssd and Ssd->Writable() and Ssd->GetSpace() and Ssd->Free >= SsdMinFree)
+     return Ssd->Path;
+  return Target(File, c);
+}
+
+/* Returns the archive disk for video file File, a path below videodir:
+ * the disk of its first letter, or, if its recording is striped, the disk
+ * for its segment. */
+std::string Equalizer::Target(std::string_view File, char c) {
+  int n = Segment(File);
+  if (Striped(File, n))
+     return StripeDisk(c, n);
+  return Storage(c);
+}
+
+/* '00012.ts' -> 12; 0 for anything else. */
+int Equalizer::Segment(std::string_view File) {
+  if (!EndsWith(File, ".ts") or File.size() < 9 or File[File.size() - 9] != '/')
+     return 0;
+  int n = 0;
+  for(auto c:File.substr(File.size() - 8, 5)) {
+     if (c < '0' or c > '9') return 0;
+     n = 10 * n + c - '0';
+     }
+  return n;
+}
+
+/* A recording is striped from its 2nd segment on, if its previous segment
+ * was written with at least StripeMinRate. The time a segment took is taken
+ * from the symlinks, which are created once and never modified. */
+bool Equalizer::Striped(std::string_view File, int Segment) {
+  if (!Stripe or Segment < 2)
+     return false;
+  if (!StripeMinRate)
+     return true;
+
+  char prev[16];
+  snprintf(prev, sizeof(prev), "%05d.ts", Segment - 1);
+  std::string previous(File.substr(0, File.size() - 8));
+  previous += prev;
+
+  struct stat sp, sf;
+  if (lstat(previous.c_str(), &sp))
+     return false;
+  time_t end = lstat(PathBuf(File).c_str(), &sf) == 0? sf.st_mtime : time(nullptr);
+  if (end <= sp.st_mtime)
+     return false;
+  return FileSize(previous) / (end - sp.st_mtime) >= StripeMinRate;
+}
+
+/* The disk for segment 'Segment' of a striped recording starting with 'c'.
+ * Stripe = 1: the next writable disk after the one of the previous segment;
+ * Stripe = 2: the writable disk with least I/O, then most free space. */
+std::string Equalizer::StripeDisk(char c, int Segment) {
+  auto p = Current();
+  std::vector<DiskPtr> w;
+  size_t home = 0;
+  for(size_t i = 0; i < p->Disks.size(); i++) {
+     if (i < p->DiskChars.size() and p->DiskChars[i].find(c) != std::string::npos)
+        home = w.size();
+     if (p->Disks[i]->Writable() and p->Disks[i]->GetSpace() and p->Disks[i]->Free >= gibibyte)
+        w.push_back(p->Disks[i]);
+     }
+  if (w.empty())
+     return Storage(c);
+
+  if (Stripe == 1)
+     return w[(home + Segment - 1) % w.size()]->Path;
+
+  DiskPtr best;
+  for(auto disk:w)
+     if (!best or disk->Busy < best->Busy or (disk->Busy == best->Busy and disk->Free > best->Free))
+        best = disk;
+  return best->Path;
+}
+
+
+/* Called from plugins Housekeeping(). Looks for mount changes, to
+ * put disks on- or offline while running.
+ */
+void MultiVideoDir::Housekeeping() {
+  time_t now = time(nullptr);
+  if ((now - lastscan) < 10)
+     return;
+  lastscan = now;
+
+  if (eq->Rescan() and !eq->ValidSequence())
+     SetupStore("DiskSeq", eq->SplitEqual().c_str());
+  eq->PollPower();
+  eq->CheckHealth(videodir);
+
+  if (!ssd.empty() and (now - lastmigration) >= 300) {
+     lastmigration = now;
+     eq->MigrateSsd(videodir);
+     }
+
+  /* growth per disk; disks expected to run short are relieved at night,
+   * long before Equalize() would act on its own. */
+  if ((now - lastforecast) >= 3600) {
+     lastforecast = now;
+     eq->SampleGrowth();
+     auto disks = eq->RunningShort();
+     if (balance and !disks.empty() and eq->BalanceTime()) {
+        int code;
+        std::string reply;
+        StartJob("BALANCE (forecast)", [this, disks](JobInfo& job) {
+           eq->Equalize(job, true);
+           for(auto d:disks) {
+              if (eq->Relieve(videodir, d))
+                 job.Print("relieve " + d);
+              else
+                 job.Print("relieve " + d + ": drain queue busy, next try in an hour");
+              }
+           job.Print(eq->DiskStatus());
+           }, code, reply);
+        }
+     if (!eq->SaveHeat(heatfile))
+        std::cerr << "cannot write " << heatfile << std::endl;
+     if (eq->HotEnabled() and eq->BalanceTime()) {
+        int code;
+        std::string reply;
+        StartJob("HOT", [this](JobInfo& job) { eq->MoveHot(videodir, job); }, code, reply);
+        }
+     }
+
+  /* a new mapping from a background balance is stored here, in vdrs main thread. */
+  std::string seq = eq->Sequence();
+  if (seq != diskseq)
+     SetupStore("DiskSeq", seq.c_str());
+
+  if (!metricsfile.empty() and (now - lastmetrics) >= metricsinterval) {
+     lastmetrics = now;
+     if (!WriteFile(metricsfile, MetricsText()))
+        std::cerr << "cannot write " << metricsfile << std::endl;
+     }
+}
+
+
+/* All metrics in prometheus text exposition format. Rates, ie. copy MB/s or
+ * the mean Register() latency, are derived from the counters by the server:
+ *   rate(vdirs_copy_bytes_total[5m]) / rate(vdirs_copy_seconds_total[5m])
+ */
+std::string MultiVideoDir::MetricsText() {
+  std::stringstream ss;
+  auto seconds = [](Metrics::Counter c) { return Metrics::Get(c) / 1e9; };
+  auto metric = [&ss](const char* Name, const char* Type, const char* Help) {
+     ss << "# HELP " << Name << ' ' << Help << '\n'
+        << "# TYPE " << Name << ' ' << Type << '\n';
+     };
+
+  std::vector<Vdirs_DiskInfo_v1_0::Disk> disks;
+  eq->DiskList(disks);
+
+  metric("vdirs_disk_free_bytes", "gauge", "Free space per disk.");
+  for(auto& d:disks)
+     ss << "vdirs_disk_free_bytes{disk=\"" << d.Path << "\"} " << d.FreeMB * mebibyte << '\n';
+  metric("vdirs_disk_used_bytes", "gauge", "Used space per disk.");
+  for(auto& d:disks)
+     ss << "vdirs_disk_used_bytes{disk=\"" << d.Path << "\"} " << d.UsedMB * mebibyte << '\n';
+  metric("vdirs_disk_online", "gauge", "1 if the disk is mounted and writable.");
+  for(auto& d:disks)
+     ss << "vdirs_disk_online{disk=\"" << d.Path << "\"} " << (d.Online and !d.ReadOnly) << '\n';
+
+  metric("vdirs_queue_depth", "gauge", "Background tasks waiting.");
+  ss << "vdirs_queue_depth " << eq->Queued() << '\n';
+  metric("vdirs_deferred_jobs", "gauge", "Moves waiting for a sleeping disk.");
+  ss << "vdirs_deferred_jobs " << eq->DeferredJobs() << '\n';
+  metric("vdirs_jobs_running", "gauge", "SVDRP jobs not yet finished.");
+  ss << "vdirs_jobs_running " << jobs.Running() << '\n';
+
+  metric("vdirs_copy_files_total", "counter", "Files copied between disks.");
+  ss << "vdirs_copy_files_total " << Metrics::Get(Metrics::FilesCopied) << '\n';
+  metric("vdirs_copy_bytes_total", "counter", "Bytes copied between disks.");
+  ss << "vdirs_copy_bytes_total " << Metrics::Get(Metrics::BytesCopied) << '\n';
+  metric("vdirs_copy_seconds_total", "counter", "Time spent copying.");
+  ss << "vdirs_copy_seconds_total " << seconds(Metrics::CopyNanos) << '\n';
+
+  metric("vdirs_register_calls_total", "counter", "Calls of Register().");
+  ss << "vdirs_register_calls_total " << Metrics::Get(Metrics::RegisterCalls) << '\n';
+  metric("vdirs_register_seconds_total", "counter", "Time spent in Register().");
+  ss << "vdirs_register_seconds_total " << seconds(Metrics::RegisterNanos) << '\n';
+  metric("vdirs_contains_calls_total", "counter", "Calls of Contains().");
+  ss << "vdirs_contains_calls_total " << Metrics::Get(Metrics::ContainsCalls) << '\n';
+  metric("vdirs_contains_seconds_total", "counter", "Time spent in Contains().");
+  ss << "vdirs_contains_seconds_total " << seconds(Metrics::ContainsNanos) << '\n';
+
+  metric("vdirs_balance_runs_total", "counter", "Runs of the disk balancing.");
+  ss << "vdirs_balance_runs_total " << Metrics::Get(Metrics::BalanceRuns) << '\n';
+  return ss.str();
+}
+
+
 /* Returns the total amount (in MB) of free disk space for recording.
  * If UsedMB is given, it returns the amount of disk space in use by
  * existing recordings (or anything else) on that disk.
@@ -409,19 +1741,28 @@ int MultiVideoDir::FreeMB(int* UsedMB) {
 /* Creates a symlink from FileName to location on other disk.
  *  Filename is full path incl. *.ts, beginning with videodir
  */
-bool MultiVideoDir::Register(std::string FileName) {
+bool MultiVideoDir::Register(std::string_view FileName) {
+  Metrics::Timer timer(Metrics::RegisterCalls, Metrics::RegisterNanos);
   if (debug) std::cout << "Register(" << FileName << ")" << std::endl;
 
   /* check if 'FileName' is located on videodir */
-  if (FileName.find(videodir) != 0) {
+  if (FileName.size() <= videodir.size() or FileName.compare(0, videodir.size(), videodir) != 0) {
      if (debug) std::cout << "ERROR: not in videodir" << std::endl;
      return false;
      }
 
-  std::string s = FileName.substr(videodir.size() + 1);
+  std::string_view s = FileName.substr(videodir.size() + 1);
   char c = eq->CharMapping(s);
+  eq->Registered(c);
+
+  std::string disk = eq->Landing(FileName, c);
+  if (disk.empty()) {
+     std::cerr << "Register(" << FileName << "): ERROR: no writable disk" << std::endl;
+     return false;
+     }
 
-  std::string dest = eq->Storage(c) + '/' + FlatPath(s);
+  std::string dest(disk);
+  dest.append(1, '/').append(FlatPath(s));
 
   if (debug) std::cout << "dest = " << dest << std::endl;
   return SymLink(FileName, dest);
@@ -433,49 +1774,259 @@ bool MultiVideoDir::Register(std::string FileName) {
  *   To:    full dir path incl. '*.del' */
 bool MultiVideoDir::Rename(std::string From, std::string To) {
   if (debug) std::cout << "Rename(" << From << "," << To << ")" << std::endl;
-  return ::Rename(From, To);
+  std::lock_guard<std::mutex> lock(movemutex);
+  Emptied(From);
+  if (!::Rename(From, To))
+     return false;
+
+  /* ie. '*.rec' -> '*.del': the links of shared files are known by their paths. */
+  DirSnapshot list(To, true);
+  char buf[PATH_MAX];
+  for(size_t i = 0; i < list.Count(); i++)
+     if (list.IsSymlink(i) and IsVideoFile(list.CName(i))) {
+        std::string link = list.Path(i);
+        std::string dest(LinkDest(link, buf, sizeof(buf)));
+        if (OnDisk(dest) and eq->Shared.Shared(dest))
+           eq->Shared.Renamed(dest, From + link.substr(To.size()), link);
+        }
+  return true;
 }
 
 
-/* Moves a directory / change its Name.
+/*******************************************************************************
+ * struct MoveStep
+ * One video file of a Move(): its link, the file before and after the rename
+ * on its disk and the disk, where it finally belongs to.
+ ******************************************************************************/
+struct MoveStep {
+  std::string Link;
+  std::string From;
+  std::string To;
+  std::string Disk;
+  bool Done;
+};
+
+
+/* Moves a directory / change its Name, incl. all subdirs.
  *    From:  full dir path incl. '*.rec'
- *    To:    full dir path incl. '*.rec' */
+ *    To:    full dir path incl. '*.rec'
+ * The files are renamed to their new flat names on their disks first, one
+ * thread per disk, and each link is replaced atomically. Files on the wrong
+ * disk are moved afterwards in background. Each step is logged to movelog,
+ * so that an interrupted Move() is rolled back on next start.
+ */
 bool MultiVideoDir::Move(std::string From, std::string To) {
   if (debug) std::cout << "Move(" << From << "," << To << ")" << std::endl;
+  std::lock_guard<std::mutex> lock(movemutex);
+  Emptied(From);
 
-  ::Rename(From, To);
+  if (!::Rename(From, To))
+     return false;
 
-  std::string subdir = To.substr(videodir.size() + 1);
-  std::string nextdisk(eq->Storage(eq->CharMapping(subdir)));
+  /* the plan: a recording, which is striped, keeps its segments on their disks. */
+  DirSnapshot list(To, true);
+  std::vector<MoveStep> steps;
+  std::vector<uint32_t> parents;
+  std::map<uint32_t, std::set<std::string>> disks;
+  char buf[PATH_MAX];
+  for(size_t i = 0; i < list.Count(); i++)
+     if (list.IsSymlink(i) and IsVideoFile(list.CName(i))) {
+        std::string link = list.Path(i);
+        std::string from(LinkDest(link, buf, sizeof(buf)));
+        std::string disk = from.substr(0, from.rfind('/'));
+        if (!OnDisk(from)) continue;
+        disks[list[i].Parent].insert(disk);
+        parents.push_back(list[i].Parent);
+        /* a file shared with other links keeps its name. */
+        if (eq->Shared.Shared(from))
+           steps.push_back({ link, from, from, "", false });
+        else
+           steps.push_back({ link, from, disk + '/' + FlatPath(link.substr(videodir.size() + 1)), "", false });
+        }
+  /* the links of shared files are known by their paths. */
+  auto renamed = [&]() {
+     for(auto& s:steps)
+        if (s.From == s.To)
+           eq->Shared.Renamed(s.From, From + s.Link.substr(To.size()), s.Link);
+     };
+  for(size_t i = 0; i < steps.size(); i++) {
+     auto& s = steps[i];
+     if (s.From == s.To)
+        continue;
+     s.Disk = disks[parents[i]].size() > 1? s.From.substr(0, s.From.rfind('/')) :
+              eq->Storage(eq->CharMapping(s.Link.substr(videodir.size() + 1)));
+     }
 
-  for(auto e:cFileList(To).List()) {
-     auto linkname = To + '/' + e;
-     if (IsSymlink(linkname) and IsVideoFile(linkname)) {
-        std::string linkdest = LinkDest(linkname);
-        std::string current_disk = linkdest.substr(0, linkdest.rfind('/'));
-        std::string newdest(nextdisk + '/' + FlatPath(subdir));
+  /* the log is on the disk before the first rename, see RecoverMove(). */
+  std::string plan("MOVE\t" + From + '\t' + To + '\n');
+  for(auto& s:steps)
+     plan += "STEP\t" + s.Link + '\t' + s.From + '\t' + s.To + '\n';
+  int log = open(movelog.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (log < 0 or !WriteSync(log, plan) or !SyncDirectory(videodir)) {
+     std::cerr << "Move(" << From << "," << To << "): cannot write " << movelog
+               << ", files keep their names" << std::endl;
+     if (log >= 0) {
+        close(log);
+        ::Remove(movelog);
+        }
+     renamed();
+     return true;
+     }
 
-        if (current_disk == nextdisk) {
-           if (debug) std::cout << "rename " << linkdest << " to " << newdest << std::endl;
-           ::Rename(linkdest, newdest);
-           }
-        else {
-           if (debug) std::cout << "bg move " << linkdest << " to " << newdest << std::endl;
-           eq->BgMove(linkdest, newdest);
+  /* same disk renames, in parallel for different disks. */
+  std::map<std::string, std::vector<MoveStep*>> perdisk;
+  for(auto& s:steps)
+     if (s.From != s.To)
+        perdisk[s.From.substr(0, s.From.rfind('/'))].push_back(&s);
+  std::mutex logmutex;
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> threads;
+  for(auto& d:perdisk)
+     threads.emplace_back([&, d]() {
+        for(auto s:d.second) {
+           if (failed) break;
+           if (debug) std::cout << "rename " << s->From << " to " << s->To << std::endl;
+           if (!::Rename(s->From, s->To)) {
+              failed = true;
+              break;
+              }
+           s->Done = true;
+           if (!ReplaceSymLink(s->Link, s->To)) {
+              failed = true;
+              break;
+              }
+           std::lock_guard<std::mutex> lock(logmutex);
+           WriteSync(log, "DONE\t" + s->Link + '\n');
            }
-        ::Remove(linkname);
-        SymLink(linkname, newdest);
-        }
+        });
+  for(auto& t:threads)
+     t.join();
+
+  if (failed) {
+     std::cerr << "Move(" << From << "," << To << "): failed, rolling back" << std::endl;
+     Rollback(steps, From, To);
+     close(log);
+     ::Remove(movelog);
+     return false;
+     }
+  WriteSync(log, "COMMIT\n");
+  close(log);
+  ::Remove(movelog);
+  renamed();
+
+  /* the heat of a recording is kept by its flat name, which changed. */
+  std::map<std::string, std::string> keys;
+  for(auto& s:steps)
+     if (s.From != s.To)
+        keys[std::string(Recording(s.From.c_str() + s.From.rfind('/') + 1))] =
+           std::string(Recording(s.To.c_str() + s.To.rfind('/') + 1));
+  for(auto& k:keys)
+     eq->Heat.Rename(k.first, k.second);
+
+  /* cross disk moves are kept as deferred jobs of their target disk and in
+   * movepending, so that neither a full queue nor a restart loses them; the
+   * links are replaced once a copy is complete. */
+  std::string pending;
+  for(auto& s:steps)
+     if (!s.Disk.empty() and s.To.compare(0, s.Disk.size() + 1, s.Disk + '/') != 0)
+        pending += "MOVE\t" + s.Link + '\t' + s.To + '\t' + s.Disk + s.To.substr(s.To.rfind('/')) + '\n';
+  if (!pending.empty()) {
+     int f = open(movepending.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+     if (f < 0 or !WriteSync(f, pending))
+        std::cerr << "Move(" << From << "," << To << "): cannot write " << movepending << std::endl;
+     if (f >= 0)
+        close(f);
      }
+  size_t left = 0;
+  for(auto& s:steps)
+     if (!s.Disk.empty() and s.To.compare(0, s.Disk.size() + 1, s.Disk + '/') != 0 and
+         !DeferMove(s.Link, s.To, s.Disk + s.To.substr(s.To.rfind('/'))))
+        left++;
+  if (left)
+     std::cerr << "Move(" << From << "," << To << "): " << left
+               << " files left on their disk, no such disk" << std::endl;
   return true;
 }
 
+/* Undoes the finished steps of a Move() in reverse order. */
+void MultiVideoDir::Rollback(std::vector<MoveStep>& Steps, const std::string& From, const std::string& To) {
+  for(auto it = Steps.rbegin(); it != Steps.rend(); ++it) {
+     if (!it->Done) continue;
+     if (IsFile(it->To) and !IsFile(it->From))
+        ::Rename(it->To, it->From);
+     ReplaceSymLink(it->Link, it->From);
+     it->Done = false;
+     }
+  ::Rename(To, From);
+}
+
+/* Rolls back a Move(), which was interrupted by a crash or power loss. */
+void MultiVideoDir::RecoverMove() {
+  std::ifstream is(movelog);
+  if (!is)
+     return;
+
+  std::string line, From, To;
+  std::vector<MoveStep> steps;
+  std::set<std::string> done;
+  bool committed = false;
+  while(std::getline(is, line)) {
+     auto f = SplitStr(line, '\t');
+     if      (f.size() == 3 and f[0] == "MOVE") { From = f[1]; To = f[2]; }
+     else if (f.size() == 4 and f[0] == "STEP") steps.push_back({ f[1], f[2], f[3], "", false });
+     else if (f.size() == 2 and f[0] == "DONE") done.insert(f[1]);
+     else if (f.size() == 1 and f[0] == "COMMIT") committed = true;
+     }
+  is.close();
+
+  if (!committed and !From.empty()) {
+     std::cerr << "rolling back interrupted Move(" << From << "," << To << ")" << std::endl;
+     /* a rename may have happened w/o its DONE line. */
+     for(auto& s:steps)
+        s.Done = done.count(s.Link) or (IsFile(s.To) and !IsFile(s.From));
+     Rollback(steps, From, To);
+     }
+  ::Remove(movelog);
+}
+
+/* Queues the move of the file From, the target of Link, to To as deferred
+ * job of the disk of To. */
+bool MultiVideoDir::DeferMove(const std::string& Link, const std::string& From, const std::string& To) {
+  return eq->Defer(To.substr(0, To.rfind('/')), Link, [e = eq, Link, From, To]() {
+     if (LinkDest(Link) == From)
+        e->Relink(Link, From, To);
+     }, true);
+}
+
+/* Queues again the cross disk moves of Move(), which were not done before
+ * the last stop; the others, done or obsolete, are dropped from movepending.
+ */
+void MultiVideoDir::RecoverPending() {
+  std::ifstream is(movepending);
+  if (!is)
+     return;
+
+  std::string line, kept;
+  while(std::getline(is, line)) {
+     auto f = SplitStr(line, '\t');
+     if (f.size() == 4 and f[0] == "MOVE" and LinkDest(f[1]) == f[2] and DeferMove(f[1], f[2], f[3]))
+        kept += line + '\n';
+     }
+  is.close();
+
+  if (kept.empty())
+     ::Remove(movepending);
+  else if (!WriteFile(movepending, kept))
+     std::cerr << "cannot write " << movepending << std::endl;
+}
+
 
 /* Removes the directory with the given Name and everything it contains.
  * Name is a full path name that begins with the name of the video directory.
  * Returns true if the operation was successful.*/
 bool MultiVideoDir::Remove(std::string Name) {
   if (debug) std::cout << "Remove(" << Name << ")" << std::endl;
+  Emptied(Name);
   if (IsFile(Name)) {
      if (debug) std::cout << "IsFile = true" << std::endl;
      return ::Remove(Name);
@@ -485,12 +2036,17 @@ bool MultiVideoDir::Remove(std::string Name) {
         std::cout << "IsSymlink = true; -> Remove(" << LinkDest(Name)
                   << ") && Remove(" << Name << ")" << std::endl;
         }
-     return ::Remove(LinkDest(Name)) and ::Remove(Name);
+     std::string dest = LinkDest(Name);
+     if (!eq->Shared.Release(dest, Name))
+        return ::Remove(Name);
+     eq->Removed(dest.substr(0, dest.rfind('/')), FileSize(dest));
+     return ::Remove(dest) and ::Remove(Name);
      }
   else if (IsDirectory(Name)) {
      if (debug) std::cout << "IsDirectory = true" << std::endl;
-     for(auto s:cFileList(Name).List())
-        Remove(Name + '/' + s);
+     DirSnapshot list(Name);
+     for(size_t i = 0; i < list.Count(); i++)
+        Remove(list.Path(i));
      return ::Remove(Name);
      }
   else {
@@ -520,51 +2076,250 @@ void MultiVideoDir::Cleanup(const char* IgnoreFiles[]) {
      std::cout << "')" << std::endl;
      }
 
-  cVideoDirectory::Cleanup(IgnoreFiles);
+  /* the first time, nothing is known about the tree. */
+  if (!cleanedup) {
+     cleanedup = true;
+     std::lock_guard<std::mutex> lock(cleanupmutex);
+     emptied.clear();
+     cVideoDirectory::Cleanup(IgnoreFiles);
+     return;
+     }
+
+  std::set<std::string> dirs;
+  {
+    std::lock_guard<std::mutex> lock(cleanupmutex);
+    dirs.swap(emptied);
+  }
+
+  /* deepest first, so that a parent sees its children removed. */
+  for(auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
+     std::string dir(*it);
+     while(dir.size() > videodir.size() and RemoveIfEmpty(dir, IgnoreFiles))
+        dir.erase(dir.rfind('/'));
+     }
+}
+
+/* Remembers the directory holding Path as candidate for Cleanup(). */
+void MultiVideoDir::Emptied(const std::string& Path) {
+  size_t p = Path.rfind('/');
+  if (p == std::string::npos or p <= videodir.size() or Path.compare(0, videodir.size(), videodir) != 0)
+     return;
+  std::lock_guard<std::mutex> lock(cleanupmutex);
+  emptied.insert(Path.substr(0, p));
+}
+
+/* Removes Dir, if neither it nor its subdirs contain anything else than
+ * IgnoreFiles. Returns true, if Dir is gone. */
+bool MultiVideoDir::RemoveIfEmpty(const std::string& Dir, const char* IgnoreFiles[]) {
+  if (!IsDirectory(Dir))
+     return !IsSymlink(Dir) and !IsFile(Dir);
+
+  DirSnapshot list(Dir);
+  std::vector<std::string> ignored;
+  for(size_t i = 0; i < list.Count(); i++) {
+     if (list.IsDirectory(i)) {
+        if (!RemoveIfEmpty(list.Path(i), IgnoreFiles))
+           return false;
+        continue;
+        }
+     bool ignore = false;
+     for(const char** ig = IgnoreFiles; ig and *ig and !ignore; ig++)
+        ignore = strcmp(list.CName(i), *ig) == 0;
+     if (!ignore)
+        return false;
+     ignored.push_back(list.Path(i));
+     }
+
+  for(auto& f:ignored)
+     ::Remove(f);
+  if (debug) std::cout << "Cleanup: removing " << Dir << std::endl;
+  return ::Remove(Dir);
+}
+
+
+/* returns true, if Path is located on one of our disks, incl. the SSD. */
+bool MultiVideoDir::OnDisk(std::string_view Path) {
+  if (Path.compare(0, mountprefix.size(), mountprefix) == 0)
+     return true;
+  return !ssd.empty() and Path.size() > ssd.size() and
+         Path.compare(0, ssd.size(), ssd) == 0 and Path[ssd.size()] == '/';
 }
 
 
 /* returns true, if deleting file 'Name' would release disk space on
  * the video dirs for new recordings. */
-bool MultiVideoDir::Contains(std::string Name) {
+bool MultiVideoDir::Contains(std::string_view Name) {
+  Metrics::Timer timer(Metrics::ContainsCalls, Metrics::ContainsNanos);
   if (debug) std::cout << "Contains(" << Name << ")" << std::endl;
   if (IsSymlink(Name)) {
-     if (debug) {
-        std::cout << "IsSymlink = true; result = ";
-        if (LinkDest(Name).find(mountprefix) == 0)
-           std::cout << "true" << std::endl;
-        else
-           std::cout << "false" << std::endl;
-        }
-     return LinkDest(Name).find(mountprefix) == 0;
+     char buf[PATH_MAX];
+     bool result = OnDisk(LinkDest(Name, buf, sizeof(buf)));
+     if (debug)
+        std::cout << "IsSymlink = true; result = " << (result? "true" : "false") << std::endl;
+     return result;
      }
   else if (IsFile(Name)) {
-     if (debug) {
-        std::cout << "IsFile = true; result = ";
-        if (Name.find(mountprefix) == 0)
-           std::cout << "true" << std::endl;
-        else
-           std::cout << "false" << std::endl;
-        }
-     return Name.find(mountprefix) == 0;
+     bool result = OnDisk(Name);
+     if (debug)
+        std::cout << "IsFile = true; result = " << (result? "true" : "false") << std::endl;
+     return result;
      }
   return false;
 }
 
-void MultiVideoDir::Balance() {
-  eq->Equalize();
+void MultiVideoDir::Balance(JobInfo& job) {
+  eq->Equalize(job);
+  job.Print(eq->DiskStatus());
+}
+
+/* Reports links w/o target and files on the disks w/o link. */
+void MultiVideoDir::Verify(JobInfo& job) {
+  PathStore Targets;
+  std::vector<bool> linked;
+  size_t links = 0, dangling = 0, orphans = 0, orphanbytes = 0;
+  char buf[PATH_MAX];
+
+  DirSnapshot tree(videodir, true);
+  for(size_t i = 0; i < tree.Count() and !job.Cancelled(); i++) {
+     if (!tree.IsSymlink(i)) continue;
+     std::string link(tree.Path(i));
+     std::string_view dest = LinkDest(link, buf, sizeof(buf));
+     if (!OnDisk(dest)) continue;
+     links++;
+     /* the target is looked up on its disk; counts for the disks health. */
+     struct stat st;
+     auto start = std::chrono::steady_clock::now();
+     bool exists = stat(std::string(dest).c_str(), &st) == 0;
+     Health::Record(dest, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start).count(), exists or errno == ENOENT);
+     if (!exists) {
+        dangling++;
+        job.Print("dangling: " + link + " -> " + std::string(dest));
+        continue;
+        }
+     auto h = Targets.Intern(dest);
+     if (h >= linked.size()) linked.resize(h + 1);
+     linked[h] = true;
+     }
+
+  for(auto& disk:ScanDirs(eq->DiskPaths(), false, true)) {
+     for(size_t i = 0; i < disk.Count() and !job.Cancelled(); i++) {
+        if (!disk.IsFile(i)) continue;
+        std::string file(disk.Path(i));
+        auto h = Targets.Find(file);
+        if (h != PathStore::npos and h < linked.size() and linked[h]) continue;
+        orphans++;
+        orphanbytes += disk.Size(i);
+        job.Print("orphan: " + file);
+        }
+     }
+
+  job.Print(std::to_string(links) + " links, " + std::to_string(dangling) + " dangling, " +
+            std::to_string(orphans) + " orphans (" + std::to_string(orphanbytes / mebibyte) + " MB)");
+}
+
+/* Reports video files with equal contents. With Collapse, the links to all
+ * copies are set to one of them, preferably one already shared, and the
+ * other copies are removed; the links of a shared file are kept in Shared.
+ * Files written to in the last minutes or being copied are left out.
+ */
+void MultiVideoDir::Deduplicate(JobInfo& job, bool Collapse) {
+  auto scans = ScanDirs(eq->DiskPaths(), false, true);
+  auto sets = Dedup::Find(scans, mebibyte,
+     [](const std::string& f) { return FileAge(f) < 300 or IsCopying(f); },
+     [&job]() { return job.Cancelled(); });
+
+  uint64_t reclaimable = 0, reclaimed = 0;
+  for(auto& s:sets) {
+     reclaimable += s.Size * (s.Files.size() - 1);
+     std::string line(std::to_string(s.Size / mebibyte) + "MB:");
+     for(auto& f:s.Files)
+        line += ' ' + f;
+     job.Print(line);
+     }
+  job.Print(std::to_string(sets.size()) + " sets of equal files, " +
+            std::to_string(reclaimable / mebibyte) + " MB reclaimable");
+  if (!Collapse or sets.empty() or job.Cancelled())
+     return;
+
+  /* disk file -> links. */
+  std::map<std::string, std::vector<std::string>> links;
+  char buf[PATH_MAX];
+  DirSnapshot tree(videodir, true);
+  for(size_t i = 0; i < tree.Count() and !job.Cancelled(); i++)
+     if (tree.IsSymlink(i)) {
+        std::string link(tree.Path(i));
+        links[std::string(LinkDest(link, buf, sizeof(buf)))].push_back(link);
+        }
+
+  /* the files are compared first; that reads them and takes a while. */
+  std::vector<std::pair<std::string, std::vector<std::string>>> equal;
+  for(auto& s:sets) {
+     if (job.Cancelled())
+        return;
+     std::string keep = s.Files[0];
+     for(auto& f:s.Files)
+        if (eq->Shared.Shared(f)) {
+           keep = f;
+           break;
+           }
+     if (links[keep].empty())
+        continue;
+     std::vector<std::string> files;
+     for(auto& f:s.Files)
+        if (f != keep and Dedup::Equal(keep, f))
+           files.push_back(f);
+     if (!files.empty())
+        equal.push_back(std::make_pair(keep, files));
+     }
+
+  /* files drained or relinked meanwhile are left out. */
+  std::lock_guard<std::mutex> lock(movemutex);
+  for(auto& e:equal) {
+     auto& keep = e.first;
+     struct stat st;
+     if (IsCopying(keep) or stat(keep.c_str(), &st) != 0)
+        continue;
+     auto& kept = links[keep];
+     for(auto& f:e.second) {
+        if (IsCopying(f))
+           continue;
+        auto& moved = links[f];
+        std::vector<std::string> left;
+        for(auto& l:moved) {
+           if (LinkDest(l) != f)
+              continue;
+           if (ReplaceSymLink(l, keep))
+              kept.push_back(l);
+           else
+              left.push_back(l);
+           }
+        eq->Shared.Set(keep, kept);
+        eq->Shared.Set(f, left);
+        if (left.empty() and ::Remove(f)) {
+           eq->Removed(f.substr(0, f.rfind('/')), st.st_size);
+           reclaimed += st.st_size;
+           }
+        moved.clear();
+        }
+     }
+  job.Print(std::to_string(reclaimed / mebibyte) + " MB reclaimed, " +
+            std::to_string(eq->Shared.Count()) + " shared files");
 }
 
-void MultiVideoDir::Import(std::string Path, bool One, bool DryRun) {
-  for(auto e:cFileList(Path).List())
-     if (IsDirectory(Path + '/' + e)) {
+void MultiVideoDir::Import(JobInfo& job, std::string Path, bool One, bool DryRun) {
+  DirSnapshot list(Path);
+  for(size_t i = 0; i < list.Count() and !job.Cancelled(); i++)
+     if (list.IsDirectory(i)) {
+        std::string e(list.Name(i));
         char c = eq->CharMapping(e);
-        if (DryRun) {
-           ImportData d = std::make_tuple(videodir, eq->Storage(c), Path, e, true);
-           ImportWork(d);
+        std::string disk = eq->Storage(c);
+        if (disk.empty()) {
+           job.Print("ERROR: no writable disk for " + e + ", import stopped");
+           return;
            }
-        else
-           eq->BgImport(videodir, eq->Storage(c), Path, e);
+        ImportData d = std::make_tuple(videodir, disk, Path, e, DryRun);
+        ImportWork(d, job);
         if (One) return;
         }
 
@@ -4,10 +4,21 @@
  */
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <ctime>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <mutex>
 #include <vdr/videodir.h>
+#include "setup.h"
+#include "jobs.h"
 
 class Equalizer;
+class MetricsSocket;
+struct MoveStep;
 
 /******************* Plugins.html (vdr-2.3.8) **********************************
  * The video directory
@@ -27,33 +38,65 @@ friend class DiskUse;
 private:
   std::string videodir;
   std::string mountprefix;
+  std::string ssd;
   Equalizer* eq;
   bool balance;
-  bool debug;
+  std::atomic<bool> debug;
+  time_t lastscan;
+  time_t lastmigration;
+  JobList jobs;
+  std::string metricsfile;
+  int metricsinterval;
+  time_t lastmetrics;
+  std::unique_ptr<MetricsSocket> metricssocket;
+  std::string diskseq;
+  time_t lastforecast;
+  std::mutex cleanupmutex;
+  std::set<std::string> emptied;  /* dirs, which may have lost their last file. */
+  bool cleanedup;
+  std::mutex movemutex;
+  std::string movelog;
+  std::string movepending;   /* cross disk moves not done yet, one per line. */
+  std::string heatfile;
+  std::vector<std::pair<std::string, double>> startup;  /* ms per step of constructor. */
 
-  // private versions with c++11 strings
-  bool Register(std::string FileName);
+  // private versions with c++11 strings; string_view for the hot ones.
+  bool Register(std::string_view FileName);
   bool Rename(std::string From, std::string To);
   bool Move(std::string From, std::string To);
   bool Remove(std::string Name);
-  bool Contains(std::string Name);
+  bool Contains(std::string_view Name);
+  bool OnDisk(std::string_view Path);
+  void Emptied(const std::string& Path);
+  bool RemoveIfEmpty(const std::string& Dir, const char* IgnoreFiles[]);
+  void Rollback(std::vector<MoveStep>& Steps, const std::string& From, const std::string& To);
+  void RecoverMove();
+  bool DeferMove(const std::string& Link, const std::string& From, const std::string& To);
+  void RecoverPending();
 
   //void ImportVideo(std::string Disk, std::string TopSrc, std::string Dir, bool DryRun);
-  void Balance();
+  void Balance(JobInfo& job);
+  void Verify(JobInfo& job);
+  void Deduplicate(JobInfo& job, bool Collapse);
+  std::string MetricsText();
+  std::string StartupStatus();
+  void StartJob(std::string Command, std::function<void(JobInfo&)> Work, int& ReplyCode, std::string& Reply);
 public:
-  MultiVideoDir(std::string Prefix, std::string Seq, bool Balancing);
-  virtual ~MultiVideoDir() {}
+  MultiVideoDir(const VdirsSetup& Setup);
+  virtual ~MultiVideoDir();
   /**** VDRs cVideoDirectory Interface ******************************************/
   virtual int FreeMB(int* UsedMB = NULL);
-  virtual bool Register(const char* FileName)                   { return Register(std::string(FileName)); }
+  virtual bool Register(const char* FileName)                   { return Register(std::string_view(FileName)); }
   virtual bool Rename(const char* OldName, const char* NewName) { return Rename(std::string(OldName), std::string(NewName)); }
   virtual bool Move(const char* FromName, const char* ToName)   { return Move(std::string(FromName), std::string(ToName)); }
   virtual bool Remove(const char* Name)                         { return Remove(std::string(Name)); }
   virtual void Cleanup(const char* IgnoreFiles[] = NULL);
-  virtual bool Contains(const char* Name)                       { return Contains(std::string(Name)); }
+  virtual bool Contains(const char* Name)                       { return Contains(std::string_view(Name)); }
   /******************************************************************************/
   const char** SVDRPHelpPages();
-  const char* SVDRPCommand(std::string Command, std::string Option, int& ReplyCode);
+  bool SVDRPCommand(std::string Command, std::string Option, int& ReplyCode, std::string& Reply);
   void SetupStore(const char* Name, const char* Value);
-  void Import(std::string Path, bool One, bool DryRun);
+  bool Service(const char* Id, void* Data);
+  void Housekeeping();
+  void Import(JobInfo& job, std::string Path, bool One, bool DryRun);
 };
@@ -0,0 +1,95 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>     /* memcpy() */
+#include "pathstore.h"
+
+
+std::string_view PathStore::NodeName(Handle h) const {
+  const Node& n = nodes[h];
+  return std::string_view(blocks[n.Block].get() + n.Offset, n.Length);
+}
+
+/* Splits Path at '/' and looks up each component below the one before.
+ * With Add, missing components are added; otherwise npos is returned.
+ */
+PathStore::Handle PathStore::Lookup(std::string_view Path, bool Add) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Handle h = npos;
+
+  while(!Path.empty()) {
+     size_t p = Path.find('/');
+     std::string_view name = Path.substr(0, p);
+     Path = (p == std::string_view::npos)? std::string_view() : Path.substr(p + 1);
+     if (name.empty())
+        continue;
+
+     auto it = index.find(Key{h, name});
+     if (it != index.end()) {
+        h = it->second;
+        continue;
+        }
+     if (!Add or name.size() >= BlockSize)
+        return npos;
+
+     if ((used + name.size()) > BlockSize) {
+        blocks.emplace_back(new char[BlockSize]);
+        used = 0;
+        }
+     memcpy(blocks.back().get() + used, name.data(), name.size());
+
+     Node n;
+     n.Parent = h;
+     n.Block  = blocks.size() - 1;
+     n.Offset = used;
+     n.Length = name.size();
+     used += name.size();
+
+     nodes.push_back(n);
+     h = nodes.size() - 1;
+     index.emplace(Key{n.Parent, NodeName(h)}, h);
+     }
+  return h;
+}
+
+std::string PathStore::Get(Handle h) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Handle> chain;
+  size_t len = 0;
+
+  for(; h != npos and h < nodes.size(); h = nodes[h].Parent) {
+     chain.push_back(h);
+     len += 1 + nodes[h].Length;
+     }
+
+  std::string s;
+  s.reserve(len);
+  for(auto it = chain.rbegin(); it != chain.rend(); ++it)
+     s.append(1, '/').append(NodeName(*it));
+  return s;
+}
+
+std::string_view PathStore::Name(Handle h) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return h < nodes.size()? NodeName(h) : std::string_view();
+}
+
+PathStore::Handle PathStore::Parent(Handle h) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return h < nodes.size()? nodes[h].Parent : npos;
+}
+
+size_t PathStore::Count() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return nodes.size();
+}
+
+/* memory in use, w/o the hash index. */
+size_t PathStore::Bytes() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return blocks.size() * BlockSize + nodes.capacity() * sizeof(Node);
+}
@@ -0,0 +1,59 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+/*******************************************************************************
+ * class PathStore
+ * Stores paths as a tree of interned path components. Each component, ie.
+ * a directory name or a flat file name on a disk, is stored once in an arena
+ * of fixed size blocks and referred to by a 32bit Handle.
+ * Only absolute paths. A new path component costs its name and 12 bytes, plus
+ * an entry in the hash index; a known path costs nothing.
+ * Entries are never removed; names inside the arena never move.
+ ******************************************************************************/
+class PathStore {
+public:
+  typedef uint32_t Handle;
+  static const Handle npos = 0xFFFFFFFF;
+private:
+  struct Node {
+     Handle   Parent;
+     uint32_t Block;
+     uint16_t Offset;
+     uint16_t Length;
+     };
+  struct Key {
+     Handle Parent;
+     std::string_view Name;
+     bool operator==(const Key& k) const { return Parent == k.Parent and Name == k.Name; }
+     };
+  struct KeyHash {
+     size_t operator()(const Key& k) const { return std::hash<std::string_view>()(k.Name) ^ ((size_t) k.Parent * 0x9E3779B97F4A7C15ULL); }
+     };
+  static const size_t BlockSize = 0x10000;
+  std::vector<std::unique_ptr<char[]>> blocks;
+  size_t used;
+  std::vector<Node> nodes;
+  std::unordered_map<Key, Handle, KeyHash> index;
+  mutable std::mutex mutex;
+  std::string_view NodeName(Handle h) const;
+  Handle Lookup(std::string_view Path, bool Add);
+public:
+  PathStore() : used(BlockSize) {}
+  Handle Intern(std::string_view Path) { return Lookup(Path, true); }
+  Handle Find(std::string_view Path)   { return Lookup(Path, false); }
+  std::string Get(Handle h) const;
+  std::string_view Name(Handle h) const;
+  Handle Parent(Handle h) const;
+  size_t Count() const;
+  size_t Bytes() const;
+};
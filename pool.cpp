@@ -0,0 +1,79 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include "pool.h"
+
+
+WorkerPool::WorkerPool(size_t MaxThreads, int IdleSeconds) :
+   maxThreads(MaxThreads), idle(0), started(0), idleTime(IdleSeconds), stopping(false) {
+  if (maxThreads == 0)
+     maxThreads = std::max(4U, std::thread::hardware_concurrency());
+}
+
+WorkerPool::~WorkerPool() {
+  std::unique_lock<std::mutex> lock(mutex);
+  stopping = true;
+  wakeup.notify_all();
+  finished.wait(lock, [this]() { return workers.size() == exited.size(); });
+  Reap();
+}
+
+/* joins threads, which ended. Needs mutex locked. */
+void WorkerPool::Reap() {
+  for(auto id:exited) {
+     auto it = workers.find(id);
+     if (it != workers.end()) {
+        it->second.join();
+        workers.erase(it);
+        }
+     }
+  exited.clear();
+}
+
+void WorkerPool::Run(std::function<void()> Task) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Reap();
+  tasks.push_back(std::move(Task));
+  if (tasks.size() > idle and workers.size() < maxThreads) {
+     started++;
+     std::thread t(&WorkerPool::Worker, this);
+     workers.emplace(t.get_id(), std::move(t));
+     }
+  else
+     wakeup.notify_one();
+}
+
+void WorkerPool::Worker() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true) {
+     if (!tasks.empty()) {
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+        continue;
+        }
+     if (stopping)
+        break;
+     idle++;
+     bool woken = wakeup.wait_for(lock, idleTime, [this]() { return stopping or !tasks.empty(); });
+     idle--;
+     if (!woken)
+        break;
+     }
+  exited.push_back(std::this_thread::get_id());
+  finished.notify_all();
+}
+
+std::string WorkerPool::Status() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::stringstream ss;
+  ss << "threads: " << (workers.size() - exited.size() - idle) << " busy, " << idle << " idle, "
+     << started << " started, " << tasks.size() << " tasks waiting";
+  return ss.str();
+}
@@ -0,0 +1,42 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+/*******************************************************************************
+ * class WorkerPool
+ * Threads for all background work. A thread is started only if a task has to
+ * wait otherwise, and ends after IdleSeconds w/o work; an idle plugin has no
+ * threads at all. The destructor runs the tasks left and joins all threads.
+ ******************************************************************************/
+class WorkerPool {
+private:
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::condition_variable finished;
+  std::deque<std::function<void()>> tasks;
+  std::map<std::thread::id, std::thread> workers;
+  std::vector<std::thread::id> exited;
+  size_t maxThreads;
+  size_t idle;
+  size_t started;
+  std::chrono::seconds idleTime;
+  bool stopping;
+  void Worker();
+  void Reap();
+public:
+  WorkerPool(size_t MaxThreads = 0, int IdleSeconds = 30);
+  ~WorkerPool();
+  void Run(std::function<void()> Task);
+  std::string Status();
+};
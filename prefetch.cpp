@@ -0,0 +1,218 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>         /* snprintf() */
+#include <fcntl.h>        /* open(), posix_fadvise() */
+#include <unistd.h>       /* read(), close() */
+#include <poll.h>         /* poll() */
+#include <sys/inotify.h>
+#include "prefetch.h"
+#include "fops.h"
+#include "dirwalk.h"
+
+
+Prefetcher::Prefetcher(std::string VideoDir, size_t Bytes, std::function<void(const std::string& Disk, const std::string& File)> Played) :
+   played(Played), videodir(VideoDir), bytes(Bytes), running(false) {
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+     std::cerr << "Prefetcher: inotify not available" << std::endl;
+     return;
+     }
+  running = true;
+  thread = std::thread(&Prefetcher::Action, this);
+}
+
+Prefetcher::~Prefetcher() {
+  running = false;
+  if (thread.joinable())
+     thread.join();
+  if (fd >= 0)
+     close(fd);
+}
+
+void Prefetcher::Watch(const std::vector<std::string>& Disks) {
+  if (fd < 0)
+     return;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::set<std::string> wanted(Disks.begin(), Disks.end());
+
+  for(auto it = watches.begin(); it != watches.end();) {
+     if (wanted.erase(it->second) == 0) {
+        inotify_rm_watch(fd, it->first);
+        it = watches.erase(it);
+        }
+     else
+        ++it;
+     }
+  for(auto& d:wanted) {
+     int wd = inotify_add_watch(fd, d.c_str(), IN_ACCESS | IN_ONLYDIR);
+     if (wd < 0)
+        std::cerr << "Prefetcher: cannot watch " << d << std::endl;
+     else
+        watches[wd] = d;
+     }
+}
+
+void Prefetcher::Action() {
+  alignas(inotify_event) char buf[16384];
+
+  while(running) {
+     pollfd p = { fd, POLLIN, 0 };
+     if (poll(&p, 1, 1000) <= 0)
+        continue;
+
+     ssize_t n = read(fd, buf, sizeof(buf));
+     for(char* e = buf; n > 0 and e < buf + n;) {
+        const inotify_event* ev = (const inotify_event*) e;
+        e += sizeof(inotify_event) + ev->len;
+        if (!ev->len or (ev->mask & IN_ISDIR))
+           continue;
+
+        std::string disk;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          auto it = watches.find(ev->wd);
+          if (it == watches.end())
+             continue;
+          disk = it->second;
+        }
+        Accessed(disk, ev->name);
+        }
+     }
+}
+
+/* Collects the directories below Dir, whose names give Parts[i..] by
+ * FlatPath(): '.' as '_', and the recording dir w/o '.rec' or '.del'. Only
+ * the dirs on the way to the recording are read, never the whole tree. */
+static void FindDirs(const std::string& Dir, const std::vector<std::string>& Parts, size_t i, std::vector<std::string>& Result) {
+  if (i == Parts.size()) {
+     Result.push_back(Dir);
+     return;
+     }
+  DirSnapshot list(Dir);
+  for(size_t j = 0; j < list.Count(); j++) {
+     if (!list.IsDirectory(j))
+        continue;
+     std::string n(list.Name(j));
+     if (i + 1 == Parts.size() and (EndsWith(n, ".rec") or EndsWith(n, ".del")))
+        n.erase(n.size() - 4);
+     std::replace(n.begin(), n.end(), '.', '_');
+     if (n == Parts[i])
+        FindDirs(list.Path(j), Parts, i + 1, Result);
+     }
+}
+
+/* The file of segment Segment + 1 of the recording, whose segment Segment
+ * is Path, a file on a disk; or empty, if there is none. The directory of the
+ * recordings links is found once from Key, 'name~date~', and checked by the
+ * link of Segment; then the next link tells the disk. Videodir is on the
+ * system disk, the disks are not touched.
+ */
+std::string Prefetcher::NextSegment(const std::string& Path, const std::string& Key, int Segment) {
+  char name[16];
+  char buf[PATH_MAX];
+  std::string dir;
+  bool known;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = dirs.find(Key);
+    known = it != dirs.end();
+    if (known)
+       dir = it->second;
+  }
+
+  if (!known) {
+     std::vector<std::string> parts, found;
+     std::string part;
+     std::istringstream ss(Key);
+     while(std::getline(ss, part, '~'))
+        parts.push_back(part);
+     if (!parts.empty())
+        FindDirs(videodir, parts, 0, found);
+     snprintf(name, sizeof(name), "/%05d.ts", Segment);
+     for(auto& f:found)
+        if (LinkDest(f + name, buf, sizeof(buf)) == Path) {
+           dir = f;
+           break;
+           }
+     /* not found is also kept, ie. for files without a link. */
+     std::lock_guard<std::mutex> lock(mutex);
+     if (dirs.size() > 64)
+        dirs.erase(dirs.begin());
+     dirs[Key] = dir;
+     }
+  if (dir.empty())
+     return "";
+
+  snprintf(name, sizeof(name), "/%05d.ts", Segment);
+  bool moved = !IsSymlink(dir + name);
+  snprintf(name, sizeof(name), "/%05d.ts", Segment + 1);
+  std::string next(LinkDest(dir + name, buf, sizeof(buf)));
+  if (next.empty() and moved) {
+     /* the recording was moved or deleted; look it up again next time. */
+     std::lock_guard<std::mutex> lock(mutex);
+     dirs.erase(Key);
+     }
+  return next;
+}
+
+/* A file 'name~date~00003.ts' on Disk is read. Every 5 seconds at most, Disk
+ * is reported as played and the disk of the next segment is found by its
+ * link; the first bytes of 'name~date~00004.ts' there are read ahead once.
+ */
+void Prefetcher::Accessed(const std::string& Disk, const std::string& Name) {
+  size_t len = Name.size();
+  if (len < 9 or !EndsWith(Name, ".ts") or Name[len - 9] != '~')
+     return;
+  int segment = 0;
+  for(size_t i = len - 8; i < len - 3; i++) {
+     if (Name[i] < '0' or Name[i] > '9') return;
+     segment = 10 * segment + Name[i] - '0';
+     }
+
+  std::string path(Disk + '/' + Name);
+  time_t now = time(nullptr);
+  std::set<std::string> disks;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    time_t& last = recent[path];
+    if ((now - last) < 5)
+       return;
+    last = now;
+    if (recent.size() > 256)
+       for(auto it = recent.begin(); it != recent.end();)
+          it = (now - it->second) > 60? recent.erase(it) : ++it;
+    for(auto& w:watches)
+       disks.insert(w.second);
+  }
+  if (IsCopying(path))
+     return;
+  played(Disk, Name);
+  if (!bytes)
+     return;
+
+  std::string nextpath = NextSegment(path, Name.substr(0, len - 8), segment);
+  std::string disk = nextpath.substr(0, nextpath.rfind('/'));
+  if (nextpath.empty() or !disks.count(disk))
+     return;
+  int f = open(nextpath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (f < 0)
+     return;
+  played(disk, "");
+  bool first;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    first = prefetched.insert(nextpath).second;
+    if (prefetched.size() > 64)
+       prefetched.erase(prefetched.begin());
+  }
+  if (first)
+     posix_fadvise(f, 0, bytes, POSIX_FADV_WILLNEED);
+  close(f);
+}
@@ -0,0 +1,49 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <ctime>
+
+/*******************************************************************************
+ * class Prefetcher
+ * Watches the disks for video files being read, ie. by a replay, by inotify.
+ * The beginning of the next segment of that recording is read ahead, so that
+ * a sleeping disk is spun up before the replay reaches the segment boundary.
+ * The next segment is found by its link below VideoDir, so only the disk
+ * holding it is touched.
+ * Played() is called for every disk involved, at most every few seconds, with
+ * the name of the file read; for the disk of the next segment, File is empty.
+ * Bytes = 0 only reports reads. Reads by CopyFile(), ie. background moves,
+ * are ignored.
+ ******************************************************************************/
+class Prefetcher {
+private:
+  std::function<void(const std::string&, const std::string&)> played;
+  std::string videodir;
+  size_t bytes;
+  int fd;
+  std::atomic<bool> running;
+  std::thread thread;
+  std::mutex mutex;
+  std::map<int, std::string> watches;     /* watch descriptor -> disk */
+  std::map<std::string, time_t> recent;   /* disk/file -> last handled */
+  std::set<std::string> prefetched;
+  std::map<std::string, std::string> dirs; /* 'name~date~' -> dir of its links */
+  void Action();
+  void Accessed(const std::string& Disk, const std::string& Name);
+  std::string NextSegment(const std::string& Path, const std::string& Key, int Segment);
+public:
+  Prefetcher(std::string VideoDir, size_t Bytes, std::function<void(const std::string& Disk, const std::string& File)> Played);
+  ~Prefetcher();
+  /* sets the disks to watch; the disks directories are flat. */
+  void Watch(const std::vector<std::string>& Disks);
+};
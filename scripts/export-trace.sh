@@ -0,0 +1,17 @@
+#!/bin/bash
+
+################################################################################
+# writes a trace for vdirs-sim from an existing video dir: one line per
+# recording, '<time> R <bytes> <name>', time is the recordings dir mtime.
+#   ./export-trace.sh /video > trace.txt
+################################################################################
+
+VIDEODIR="${1:-/video}"
+
+cd "$VIDEODIR" || exit 1
+find . -type d -name '*.rec' | while read -r REC
+do
+  TIME=`stat -c %Y "$REC"`
+  SIZE=`du -L -s -b "$REC" | cut -f1`
+  echo "$TIME R $SIZE ${REC#./}"
+done | sort -n
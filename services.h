@@ -0,0 +1,64 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <vector>
+
+/*******************************************************************************
+ * Service interface for other plugins, see cPlugin::Service() in VDRs
+ * PLUGINS.html. No video data is read. The free space of a disk is refreshed
+ * by statvfs(), but only if the disks sysfs I/O counters show I/O since the
+ * last call; a sleeping disk is not woken up. "Vdirs-RecordingDisk-v1.0"
+ * reads the symlinks of one recording in the video dir.
+ * Calling Service(Id, NULL) returns true, if the Id is supported.
+ *
+ * Example:
+ *   Vdirs_TimerFits_v1_0 t;
+ *   t.Name = "Serien~Tatort";
+ *   t.SizeMB = 6000;
+ *   cPlugin* p = cPluginManager::CallFirstService("Vdirs-TimerFits-v1.0", &t);
+ *   if (p and !t.Fits) ...
+ ******************************************************************************/
+
+/* "Vdirs-DiskInfo-v1.0": all disks incl. the optional SSD. */
+struct Vdirs_DiskInfo_v1_0 {
+  struct Disk {
+     std::string Path;
+     int Number;      /* N of /mnt/videoN, -1 for the SSD. */
+     int FreeMB;
+     int UsedMB;
+     bool Online;
+     bool ReadOnly;
+     bool Draining;
+     };
+  std::vector<Disk> Disks;      /* out */
+};
+
+/* "Vdirs-RecordingDisk-v1.0": where a recording is stored. */
+struct Vdirs_RecordingDisk_v1_0 {
+  std::string Name;             /* in:  recording dir, ie. /video/Tatort/2024-01-01.20.15.1-0.rec,
+                                 *      or its name relative to the video dir. */
+  bool Exists;                  /* out: Name has video files. */
+  std::string Disk;             /* out: disk holding most video files of Name;
+                                 *      the disk a new recording would go to, if !Exists. */
+  std::vector<std::string> Disks; /* out: all disks holding video files of Name. */
+};
+
+/* "Vdirs-QueueStatus-v1.0": background work. */
+struct Vdirs_QueueStatus_v1_0 {
+  int Jobs;                     /* out: SVDRP jobs not yet finished. */
+  int Queued;                   /* out: jobs waiting in work queues. */
+  int Deferred;                 /* out: jobs waiting for a sleeping disk. */
+};
+
+/* "Vdirs-TimerFits-v1.0": enough space for a timer on the disk its recording
+ * is written to? With an SSD, that is the SSD, as long as it has room. */
+struct Vdirs_TimerFits_v1_0 {
+  std::string Name;             /* in:  recording name, as in the timers file. */
+  int SizeMB;                   /* in:  expected size of the recording. */
+  std::string Disk;             /* out: landing disk, empty if none is writable. */
+  int FreeMB;                   /* out: free space on Disk. */
+  bool Fits;                    /* out: FreeMB >= SizeMB */
+};
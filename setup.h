@@ -0,0 +1,80 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ */
+#pragma once
+#include <string>
+#include <cstdlib>
+
+/*******************************************************************************
+ * struct VdirsSetup
+ * Plugin settings from command line and setup.conf, handed over to
+ * MultiVideoDir on plugin start.
+ ******************************************************************************/
+struct VdirsSetup {
+  std::string MountPrefix;
+  std::string DiskSeq;
+  bool Balance;
+  std::string Ssd;       /* optional landing disk for new recordings; empty = off. */
+  int SsdMinAge;         /* minutes w/o writes, until moved to archive disk. */
+  int SsdMinFree;        /* GB; below, files are moved off regardless of age. */
+  int SpinDown;          /* minutes w/o I/O, until a disk is assumed to sleep. */
+  int MaxDefer;          /* hours, a non-urgent job waits for a sleeping disk. */
+  std::string MetricsFile;   /* prometheus text file; empty = off. */
+  std::string MetricsSocket; /* unix socket serving the same text; empty = off. */
+  int MetricsInterval;   /* seconds between updates of MetricsFile. */
+  int BalanceMinFree;    /* GB; a disk below is balanced. */
+  int ForecastHorizon;   /* hours; a disk expected to run short within is balanced early. */
+  int ForecastWindow;    /* hours of history for the growth rate. */
+  int BalanceFrom;       /* hour of day, proactive balancing may start.. */
+  int BalanceTo;         /* ..and has to end. */
+  int Stripe;            /* 0: one disk per recording, 1: segments round robin, 2: segments by disk load. */
+  int StripeMinRate;     /* MB/s; slower recordings are not striped. 0 = all. */
+  int Prefetch;          /* MB read ahead of the next segment on replay. 0 = off. */
+  std::string HotDisks;  /* fast disks for often replayed recordings, ie. "0,3"; empty = off. */
+  int HotReplays;        /* replays, which make a recording hot. */
+  int HeatHalfLife;      /* days, until the replays of a recording count half. */
+  int HotBudget;         /* GB per day, moved to or from HotDisks at most. */
+  int HealthMaxErrors;   /* I/O errors within an hour, which degrade a disk. 0 = ignore. */
+  int HealthMaxLatency;  /* ms; a disk with 95% of its I/O slower is degraded. 0 = ignore. */
+  int HealthDrain;       /* 1: recordings are moved off a degraded disk. */
+
+  VdirsSetup() : MountPrefix("/mnt/video"), DiskSeq("0"), Balance(true),
+     SsdMinAge(120), SsdMinFree(20), SpinDown(15), MaxDefer(24),
+     MetricsInterval(60), BalanceMinFree(100), ForecastHorizon(72),
+     ForecastWindow(168), BalanceFrom(2), BalanceTo(6), Stripe(0), StripeMinRate(3),
+     Prefetch(64), HotReplays(3), HeatHalfLife(14), HotBudget(50),
+     HealthMaxErrors(3), HealthMaxLatency(500), HealthDrain(0) {}
+
+  /* Value as int, limited to [Min, Max]. */
+  static int Range(const std::string& Value, int Min, int Max) {
+     int n = std::atoi(Value.c_str());
+     return n < Min? Min : n > Max? Max : n;
+     }
+
+  bool Parse(std::string Name, std::string Value) {
+     if      (Name == "DiskSeq")    DiskSeq    = Value;
+     else if (Name == "SsdMinAge")  SsdMinAge  = std::atoi(Value.c_str());
+     else if (Name == "SsdMinFree") SsdMinFree = std::atoi(Value.c_str());
+     else if (Name == "SpinDown")   SpinDown   = std::atoi(Value.c_str());
+     else if (Name == "MaxDefer")   MaxDefer   = std::atoi(Value.c_str());
+     else if (Name == "MetricsInterval") MetricsInterval = std::atoi(Value.c_str());
+     else if (Name == "BalanceMinFree")  BalanceMinFree  = std::atoi(Value.c_str());
+     else if (Name == "ForecastHorizon") ForecastHorizon = Range(Value, 1, 8760);
+     else if (Name == "ForecastWindow")  ForecastWindow  = std::atoi(Value.c_str());
+     else if (Name == "BalanceFrom")     BalanceFrom     = Range(Value, 0, 23);
+     else if (Name == "BalanceTo")       BalanceTo       = Range(Value, 0, 24);
+     else if (Name == "Stripe")          Stripe          = std::atoi(Value.c_str());
+     else if (Name == "StripeMinRate")   StripeMinRate   = std::atoi(Value.c_str());
+     else if (Name == "Prefetch")        Prefetch        = std::atoi(Value.c_str());
+     else if (Name == "HotDisks")        HotDisks        = Value;
+     else if (Name == "HotReplays")      HotReplays      = std::atoi(Value.c_str());
+     else if (Name == "HeatHalfLife")    HeatHalfLife    = std::atoi(Value.c_str());
+     else if (Name == "HotBudget")       HotBudget       = std::atoi(Value.c_str());
+     else if (Name == "HealthMaxErrors")  HealthMaxErrors  = std::atoi(Value.c_str());
+     else if (Name == "HealthMaxLatency") HealthMaxLatency = std::atoi(Value.c_str());
+     else if (Name == "HealthDrain")      HealthDrain      = std::atoi(Value.c_str());
+     else return false;
+     return true;
+     }
+};
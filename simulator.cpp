@@ -0,0 +1,397 @@
+/* vdirs - A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * vdirs-sim: offline simulator for the placement and balancing of recordings.
+ * Replays a trace of recordings and deletions against a set of simulated
+ * disks, using the same placement policy as the plugin, see balance.h.
+ *
+ *   make sim
+ *   ./vdirs-sim -d 4000,4000,8000 -t trace.txt
+ *   ./vdirs-sim -d 3000,3000 -y 10 -m
+ *
+ * Trace format, one event per line, times in seconds since 1970:
+ *   <time> R <bytes> <name>    a new recording 'name' of size 'bytes'
+ *   <time> D <name>            recording 'name' deleted
+ * Lines starting with '#' are ignored. scripts/export-trace.sh creates a
+ * trace from an existing video directory.
+ */
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include <cstdlib>     /* atof() */
+#include <cmath>       /* lround(), log() */
+#include <ctime>       /* strftime() */
+#include "balance.h"
+
+const double gibibyte = 0x40000000;
+
+
+/*******************************************************************************
+ * class DiskBackend
+ * The disks seen by the simulation. Only sizes, no files.
+ ******************************************************************************/
+class DiskBackend {
+public:
+  virtual ~DiskBackend() {}
+  virtual size_t Count() const = 0;
+  virtual double Total(size_t Disk) const = 0;
+  virtual double Free(size_t Disk) const = 0;
+  virtual bool Write(size_t Disk, double Bytes) = 0;
+  virtual void Erase(size_t Disk, double Bytes) = 0;
+};
+
+/*******************************************************************************
+ * class SimDisks
+ * DiskBackend in memory.
+ ******************************************************************************/
+class SimDisks : public DiskBackend {
+private:
+  std::vector<double> total, used;
+public:
+  SimDisks(const std::vector<double>& Sizes) : total(Sizes), used(Sizes.size(), 0) {}
+  size_t Count() const                  { return total.size(); }
+  double Total(size_t Disk) const       { return total[Disk]; }
+  double Free(size_t Disk) const        { return total[Disk] - used[Disk]; }
+  bool Write(size_t Disk, double Bytes) {
+     if (Free(Disk) < Bytes) return false;
+     used[Disk] += Bytes;
+     return true;
+     }
+  void Erase(size_t Disk, double Bytes) { used[Disk] = std::max(0.0, used[Disk] - Bytes); }
+};
+
+
+struct Event {
+  time_t Time;
+  bool Delete;
+  double Size;
+  std::string Name;
+};
+
+struct Recording {
+  size_t Disk;
+  double Size;
+  char c;
+};
+
+
+/*******************************************************************************
+ * class Simulation
+ ******************************************************************************/
+class Simulation {
+private:
+  DiskBackend& disks;
+  std::vector<std::string> letters;
+  std::map<std::string, Recording> recordings;
+  double usePerChar[256] = { 0 };
+  double minFree;
+  time_t interval;
+  time_t reportEvery;
+  bool move;
+  time_t nextBalance, nextReport;
+  /* results */
+  size_t events, overflows, spilled, lost, balances, remaps;
+  double bytesMoved, maxImbalance, sumImbalance;
+  size_t samples;
+
+  size_t DiskOf(char c);
+  void Place(const Event& e);
+  void Balance();
+  void Report(time_t Now);
+  double Imbalance();
+public:
+  Simulation(DiskBackend& Disks, std::string DiskSeq, double MinFree, time_t Interval, time_t ReportEvery, bool Move);
+  void Run(std::vector<Event>& Events);
+  void Summary(time_t From, time_t To);
+};
+
+Simulation::Simulation(DiskBackend& Disks, std::string DiskSeq, double MinFree, time_t Interval, time_t ReportEvery, bool Move) :
+   disks(Disks), minFree(MinFree), interval(Interval), reportEvery(ReportEvery), move(Move),
+   nextBalance(0), nextReport(0), events(0), overflows(0), spilled(0), lost(0),
+   balances(0), remaps(0), bytesMoved(0), maxImbalance(0), sumImbalance(0), samples(0) {
+  letters = DiskSeq.empty()? SplitLetters(disks.Count()) : SequenceLetters(DiskSeq);
+}
+
+/* as Equalizer::Storage(): the disk of letter c, or the one with most free space. */
+size_t Simulation::DiskOf(char c) {
+  for(size_t i = 0; i < letters.size() and i < disks.Count(); i++)
+     if (letters[i].find(c) != std::string::npos)
+        return i;
+  size_t best = 0;
+  for(size_t i = 1; i < disks.Count(); i++)
+     if (disks.Free(i) > disks.Free(best))
+        best = i;
+  return best;
+}
+
+void Simulation::Place(const Event& e) {
+  if (e.Delete) {
+     auto it = recordings.find(e.Name);
+     if (it == recordings.end()) return;
+     disks.Erase(it->second.Disk, it->second.Size);
+     usePerChar[(uint8_t) it->second.c] -= it->second.Size;
+     recordings.erase(it);
+     return;
+     }
+
+  char c = CharMapping(e.Name);
+  size_t d = DiskOf(c);
+  if (!disks.Write(d, e.Size)) {
+     /* the disk of this letter is full: the recording ends up elsewhere or is lost. */
+     overflows++;
+     size_t best = 0;
+     for(size_t i = 1; i < disks.Count(); i++)
+        if (disks.Free(i) > disks.Free(best))
+           best = i;
+     if (!disks.Write(best, e.Size)) {
+        lost++;
+        return;
+        }
+     spilled++;
+     d = best;
+     }
+  recordings[e.Name] = { d, e.Size, c };
+  usePerChar[(uint8_t) c] += e.Size;
+}
+
+/* as Equalizer::Equalize(), optionally followed by moving all recordings to
+ * the disk of their letter, as far as there is room. */
+void Simulation::Balance() {
+  bool RunningShort = false;
+  std::vector<DiskLoad> Loads;
+  for(size_t i = 0; i < disks.Count(); i++) {
+     Loads.push_back({ disks.Total(i), disks.Free(i), 0, true });
+     if (disks.Free(i) < minFree)
+        RunningShort = true;
+     }
+  if (!RunningShort)
+     return;
+
+  balances++;
+  size_t UsePerChar[256];
+  for(int i = 0; i < 256; i++)
+     UsePerChar[i] = std::max(0.0, usePerChar[i]);
+  auto l = BalanceLetters(Loads, UsePerChar);
+  if (l.size() != disks.Count() or l == letters)
+     return;
+  letters = l;
+  remaps++;
+
+  if (!move)
+     return;
+  for(auto& r:recordings) {
+     size_t d = DiskOf(r.second.c);
+     if (d == r.second.Disk or !disks.Write(d, r.second.Size))
+        continue;
+     disks.Erase(r.second.Disk, r.second.Size);
+     r.second.Disk = d;
+     bytesMoved += r.second.Size;
+     }
+}
+
+/* difference of the fill level of the fullest and the emptiest disk, in percent. */
+double Simulation::Imbalance() {
+  double lo = 100, hi = 0;
+  for(size_t i = 0; i < disks.Count(); i++) {
+     double fill = 100.0 * (1.0 - disks.Free(i) / disks.Total(i));
+     lo = std::min(lo, fill);
+     hi = std::max(hi, fill);
+     }
+  return hi - lo;
+}
+
+void Simulation::Report(time_t Now) {
+  char date[32];
+  struct tm t;
+  gmtime_r(&Now, &t);
+  strftime(date, sizeof(date), "%Y-%m-%d", &t);
+  std::cout << date;
+  for(size_t i = 0; i < disks.Count(); i++)
+     std::cout << ' ' << std::lround(100.0 * (1.0 - disks.Free(i) / disks.Total(i))) << '%';
+  std::cout << " imbalance " << std::lround(Imbalance()) << '%';
+  for(auto& l:letters)
+     std::cout << ' ' << l;
+  std::cout << std::endl;
+}
+
+void Simulation::Run(std::vector<Event>& Events) {
+  std::stable_sort(Events.begin(), Events.end(), [](const Event& a, const Event& b) { return a.Time < b.Time; });
+  if (Events.empty()) return;
+  nextBalance = Events.front().Time + interval;
+  nextReport  = Events.front().Time;
+
+  for(auto& e:Events) {
+     while(e.Time >= nextBalance) {
+        Balance();
+        nextBalance += interval;
+        }
+     while(e.Time >= nextReport) {
+        double imb = Imbalance();
+        maxImbalance = std::max(maxImbalance, imb);
+        sumImbalance += imb;
+        samples++;
+        if (reportEvery) Report(nextReport);
+        nextReport += reportEvery? reportEvery : 86400;
+        }
+     Place(e);
+     events++;
+     }
+}
+
+void Simulation::Summary(time_t From, time_t To) {
+  std::cout << "events:        " << events << " in " << std::lround((To - From) / (365.25 * 86400)) << " years\n"
+            << "balance runs:  " << balances << ", " << remaps << " new mappings\n"
+            << "moved:         " << std::lround(bytesMoved / gibibyte) << " GB\n"
+            << "overflows:     " << overflows << " (" << spilled << " spilled, " << lost << " lost)\n"
+            << "imbalance:     " << std::lround(samples? sumImbalance / samples : 0) << "% mean, "
+                                 << std::lround(maxImbalance) << "% max\n"
+            << "mapping:      ";
+  for(auto& l:letters)
+     std::cout << ' ' << l;
+  std::cout << std::endl;
+}
+
+
+/* A synthetic trace: series with skewed first letters, a few recordings per
+ * day of 1..8 GB, most deleted after some months, some kept forever.
+ */
+static std::vector<Event> Synthetic(int Years, unsigned Seed) {
+  std::mt19937 rng(Seed);
+  /* rough first letter frequency of german and english titles. */
+  const std::string weighted("aabbcddddeefgghhiijkkllmmnnopqrssssstttuvwwxyz0123456789");
+  std::vector<std::string> series;
+  std::uniform_int_distribution<size_t> letter(0, weighted.size() - 1);
+  for(int i = 0; i < 300; i++)
+     series.push_back(std::string(1, weighted[letter(rng)]) + "series" + std::to_string(i));
+
+  std::vector<Event> result;
+  std::uniform_int_distribution<size_t> pick(0, series.size() - 1);
+  std::poisson_distribution<int> perDay(4);
+  std::lognormal_distribution<double> size(std::log(3.0), 0.5);
+  std::exponential_distribution<double> keep(1.0 / 180);
+  std::bernoulli_distribution forever(0.1);
+  time_t start = 1577836800; /* 2020-01-01 */
+  size_t n = 0;
+
+  for(int day = 0; day < Years * 365; day++)
+     for(int i = perDay(rng); i > 0; i--) {
+        time_t t = start + day * 86400 + (n % 86400);
+        std::string name = series[pick(rng)] + "/" + std::to_string(n++) + ".rec";
+        double bytes = std::min(20.0, size(rng)) * gibibyte;
+        result.push_back({ t, false, bytes, name });
+        if (!forever(rng))
+           result.push_back({ t + (time_t) (keep(rng) * 86400), true, 0, name });
+        }
+  return result;
+}
+
+static bool ReadTrace(std::string FileName, std::vector<Event>& Events) {
+  std::ifstream is(FileName.c_str());
+  if (!is) return false;
+  std::string line;
+  while(std::getline(is, line)) {
+     if (line.empty() or line[0] == '#') continue;
+     std::istringstream ss(line);
+     Event e { 0, false, 0, "" };
+     std::string op;
+     if (!(ss >> e.Time >> op)) continue;
+     e.Delete = (op == "D");
+     if (!e.Delete and !(ss >> e.Size)) continue;
+     std::getline(ss >> std::ws, e.Name);
+     if (!e.Name.empty())
+        Events.push_back(e);
+     }
+  return true;
+}
+
+static void Usage() {
+  std::cout << "usage: vdirs-sim -d <GB,GB,..> [-t trace | -y years] [options]\n"
+               "  -d <GB,GB,..>  disk sizes\n"
+               "  -t <file>      replay trace file\n"
+               "  -y <years>     replay a synthetic trace of that many years\n"
+               "  -S <seed>      seed for the synthetic trace, default 1\n"
+               "  -w             write the trace to stdout instead of running it\n"
+               "  -q <DiskSeq>   initial mapping, default: letters split equally\n"
+               "  -f <GB>        BalanceMinFree, default 100\n"
+               "  -i <hours>     balancing interval, default 24\n"
+               "  -m             move recordings after a new mapping\n"
+               "  -r <days>      print fill levels every <days> days, 0 = off, default 30\n";
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<double> sizes;
+  std::string trace, seq;
+  int years = 0;
+  unsigned seed = 1;
+  bool write = false, move = false;
+  double minfree = 100;
+  time_t interval = 24, report = 30;
+
+  for(int i = 1; i < argc; i++) {
+     std::string o(argv[i]);
+     bool arg = (i+1) < argc;
+     if      (o == "-d" and arg) {
+        std::istringstream ss(argv[++i]);
+        std::string s;
+        while(std::getline(ss, s, ','))
+           sizes.push_back(std::atof(s.c_str()) * gibibyte);
+        }
+     else if (o == "-t" and arg) trace    = argv[++i];
+     else if (o == "-y" and arg) years    = std::atoi(argv[++i]);
+     else if (o == "-S" and arg) seed     = std::atoi(argv[++i]);
+     else if (o == "-q" and arg) seq      = argv[++i];
+     else if (o == "-f" and arg) minfree  = std::atof(argv[++i]);
+     else if (o == "-i" and arg) interval = std::atoi(argv[++i]);
+     else if (o == "-r" and arg) report   = std::atoi(argv[++i]);
+     else if (o == "-w") write = true;
+     else if (o == "-m") move  = true;
+     else {
+        Usage();
+        return 1;
+        }
+     }
+
+  std::vector<Event> events;
+  if (!trace.empty()) {
+     if (!ReadTrace(trace, events)) {
+        std::cerr << "cannot read " << trace << std::endl;
+        return 1;
+        }
+     }
+  else if (years > 0)
+     events = Synthetic(years, seed);
+  else {
+     Usage();
+     return 1;
+     }
+
+  if (write) {
+     for(auto& e:events)
+        if (e.Delete) std::cout << e.Time << " D " << e.Name << '\n';
+        else          std::cout << e.Time << " R " << (uint64_t) e.Size << ' ' << e.Name << '\n';
+     return 0;
+     }
+
+  if (sizes.empty() or std::find_if(sizes.begin(), sizes.end(), [](double d) { return d <= 0; }) != sizes.end()) {
+     Usage();
+     return 1;
+     }
+  if (!seq.empty() and seq.size() != sizes.size()) {
+     std::cerr << "DiskSeq needs one letter per disk" << std::endl;
+     return 1;
+     }
+
+  SimDisks disks(sizes);
+  Simulation sim(disks, seq, minfree * gibibyte, interval * 3600, report * 86400, move);
+  sim.Run(events);
+  if (!events.empty())
+     sim.Summary(events.front().Time, events.back().Time);
+  return 0;
+}
@@ -26,7 +26,7 @@ VDRPLUGINCREATOR(cPluginVdirs); // Don't touch this!
 
 class cPluginVdirs* PluginVdirs;
 
-cPluginVdirs::cPluginVdirs(void) : mountprefix("/mnt/video"), DiskSeq("0"), balance(true) {
+cPluginVdirs::cPluginVdirs(void) : impl(nullptr) {
   PluginVdirs = this;
 }
 
@@ -48,7 +48,16 @@ const char* cPluginVdirs::CommandLineHelp() {
          "  -b <0,1>, --balance <0,1> allow or forbid disk balancing algo\n"
          "                           for reordering files on disks.\n"
          "                           1 = allow, any other value: forbid\n"
-         "                           default: 1 (allow)\n";
+         "                           default: 1 (allow)\n"
+         "  -s path,  --ssd path     fast disk, ie. a SSD, where new recordings\n"
+         "                           are written first and moved to the\n"
+         "                           other disks later. default: none\n"
+         "  -p file,  --metrics file write metrics in prometheus text format\n"
+         "                           to file, ie. for node_exporter's\n"
+         "                           textfile collector. default: none\n"
+         "  -u path,  --metrics-socket path\n"
+         "                           serve the same metrics on a local unix\n"
+         "                           socket. default: none\n";
 }
 
 /* called before MultiVideoDir constructor. */
@@ -66,7 +75,31 @@ bool cPluginVdirs::ProcessArgs(int count, char* args[]) {
            std::cerr << PluginVdirs->Name() << ": ERROR: missing arg for mount" << std::endl;
            return false;
            }
-        mountprefix = value;
+        setup.MountPrefix = value;
+        i++;
+        }
+     else if ((option == "--ssd") or (option == "-s")) {
+        if (!has_argument) {
+           std::cerr << Name() << ": ERROR: missing arg for ssd" << std::endl;
+           return false;
+           }
+        setup.Ssd = value;
+        i++;
+        }
+     else if ((option == "--metrics") or (option == "-p")) {
+        if (!has_argument) {
+           std::cerr << Name() << ": ERROR: missing arg for metrics" << std::endl;
+           return false;
+           }
+        setup.MetricsFile = value;
+        i++;
+        }
+     else if ((option == "--metrics-socket") or (option == "-u")) {
+        if (!has_argument) {
+           std::cerr << Name() << ": ERROR: missing arg for metrics-socket" << std::endl;
+           return false;
+           }
+        setup.MetricsSocket = value;
         i++;
         }
      else if ((option == "--balance") or (option == "-b")) {
@@ -74,7 +107,7 @@ bool cPluginVdirs::ProcessArgs(int count, char* args[]) {
            std::cerr << Name() << ": ERROR: missing arg for balance" << std::endl;
            return false;
            }
-        balance = (value == "1");
+        setup.Balance = (value == "1");
         i++;
         }
      else {
@@ -87,17 +120,11 @@ bool cPluginVdirs::ProcessArgs(int count, char* args[]) {
 
 /* called before MultiVideoDir constructor. */
 bool cPluginVdirs::SetupParse(const char* Name, const char* Value) {
-  std::string s(Name);
-  if (s == "DiskSeq") {
-     DiskSeq = Value;
-     return true;
-     } 
-
-  return false;
+  return setup.Parse(Name, Value);
 }
 
 /* calls MultiVideoDir constructor. */
 bool cPluginVdirs::Start(void) {
-  impl = new MultiVideoDir(mountprefix, DiskSeq, balance);
+  impl = new MultiVideoDir(setup);
   return true;
 }
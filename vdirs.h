@@ -6,13 +6,12 @@
 
 #include <vdr/plugin.h>
 #include "multidir.h"
+#include "setup.h"
 
 class cPluginVdirs : public cPlugin {
 private:
   MultiVideoDir* impl;
-  std::string mountprefix;
-  std::string DiskSeq;
-  bool balance;
+  VdirsSetup setup;
 public:
   cPluginVdirs(void);
   virtual ~cPluginVdirs() {}
@@ -23,7 +22,7 @@ public:
   virtual bool Initialize(void) { return true; }
   virtual bool Start(void);
   virtual void Stop(void) {}
-  virtual void Housekeeping(void) {}
+  virtual void Housekeeping(void) { impl->Housekeeping(); }
   virtual void MainThreadHook(void) {}
   virtual cString Active(void) { return NULL; }
   virtual time_t WakeupTime(void) { return 0; }
@@ -31,11 +30,13 @@ public:
   virtual cOsdObject *MainMenuAction(void) { return NULL; }
   virtual cMenuSetupPage *SetupMenu(void)  { return NULL; }
   virtual bool SetupParse(const char* Name, const char* Value);
-  virtual bool Service(const char *Id, void *Data = NULL) { return false; }
+  virtual bool Service(const char *Id, void *Data = NULL) { return impl? impl->Service(Id, Data) : false; }
   virtual const char **SVDRPHelpPages(void) { return impl->SVDRPHelpPages(); }
   virtual cString SVDRPCommand(const char *Command, const char *Option, int &ReplyCode) {
-     std::string Opt;
+     std::string Opt, Reply;
      if (Option) Opt = Option;
-     return impl->SVDRPCommand(std::string(Command), Opt, ReplyCode);
+     if (!impl->SVDRPCommand(std::string(Command), Opt, ReplyCode, Reply))
+        return NULL;
+     return Reply.c_str();
      }
 };
@@ -9,21 +9,25 @@
 #include <queue>
 #include <mutex>
 #include <tuple>
+#include <functional>
 #include <condition_variable>
 #include <stdexcept>
 #include "fops.h"
+#include "dirwalk.h"
+#include "pool.h"
+#include "jobs.h"
 
-typedef std::tuple<std::string, std::string, bool> CopyData;
 typedef std::tuple<std::string, std::string, std::string, std::string, bool> ImportData;
+typedef std::tuple<std::string, std::string, time_t, size_t> DrainData;
+typedef std::function<void()> Job;
 
-void CopyWork(CopyData& d) {
-  if (std::get<2>(d))
-     MoveFile(std::get<0>(d), std::get<1>(d));
-  else
-     CopyFile(std::get<0>(d), std::get<1>(d));
+void RunJob(Job& j) {
+  j();
 }
 
-void ImportWork(ImportData& d) {
+/* Output goes to the job; a cancelled import stops before the next file and
+ * leaves the source dir, with the files not yet moved, in place. */
+void ImportWork(ImportData& d, JobInfo& job) {
   std::string videodir = std::get<0>(d);
   std::string Disk     = std::get<1>(d);
   std::string TopSrc   = std::get<2>(d);
@@ -33,92 +37,125 @@ void ImportWork(ImportData& d) {
   std::string Dest(videodir + '/' + Dir);
   std::string Src(TopSrc    + '/' + Dir);
 
-  if (!DirectoryExists(Dest))
-     MakeDirectory(Dest, true, DryRun);
+  if (Disk.empty()) {
+     job.Print("ERROR: no writable disk for " + Src);
+     return;
+     }
+
+  if (!DirectoryExists(Dest)) {
+     job.Print("MakeDirectory(" + Dest + ")");
+     if (!DryRun)
+        MakeDirectory(Dest, true);
+     }
 
-  for(auto e:cFileList(Src).List()) {
+  DirSnapshot list(Src);
+  for(size_t i = 0; i < list.Count(); i++) {
+     if (job.Cancelled())
+        return;
+     std::string e(list.Name(i));
      std::string from(Src + '/' + e);
      std::string to(Dest  + '/' + e);
-     if (IsFile(from)) {
+     if (list.IsFile(i)) {
         if (IsVideoFile(from)) {
            std::string linkdest = Disk + '/' + FlatPath(Dir + '/' + e);
-           std::cerr << "SymLink(" << to << " -> " << linkdest << ")" << std::endl;
-           SymLink(to, linkdest, DryRun);
-           std::cerr << "MoveFile(" << from << ", " << linkdest << ")" << std::endl;
+           job.Print("SymLink(" + to + " -> " + linkdest + ")");
+           if (!DryRun)
+              SymLink(to, linkdest);
+           job.Print("MoveFile(" + from + ", " + linkdest + ")");
            if (!DryRun)
               MoveFile(from, linkdest);
            }
         else {
-           std::cerr << "MoveFile(" << from << ", " << to << ")" << std::endl;
+           job.Print("MoveFile(" + from + ", " + to + ")");
            if (!DryRun)
               MoveFile(from, to);
            }
         }
-     else if (IsDirectory(from)) {
+     else if (list.IsDirectory(i)) {
         ImportData d = std::make_tuple(videodir, Disk, TopSrc, Dir + '/' + e, DryRun);
-        ImportWork(d);
+        ImportWork(d, job);
         }
      }
-  std::cerr << "Remove(" << Src << ")" << std::endl;  
-  ::Remove(Src, DryRun);
-  std::cerr << "--done.--" << std::endl;
+  if (job.Cancelled())
+     return;
+  job.Print("Remove(" + Src + ")");
+  if (!DryRun)
+     ::Remove(Src);
+  job.Print("--done.--");
 }
 
 /*******************************************************************************
  * // constructor
- * WorkQueue<item_type> q(
+ * WorkQueue<item_type> q(pool,
  *    [](item_type& item) { detached_nonsequence_work(item); }   );
  *
  * // push job
  * q.Push(std::move(item));
+ *
+ * Capacity is both, the max number of items worked on in parallel and the
+ * max number of items waiting. The work is done by threads of the shared
+ * WorkerPool, which are only started if there is something to do.
  ******************************************************************************/
 
 template<typename T, typename F, typename Q = std::queue<T>>
 class WorkQueue: Q, std::mutex, std::condition_variable {
 private:
+  WorkerPool& pool;
+  F task;
   size_t capacity;
-  bool destroying;
-  std::vector<std::thread> Threads;
+  size_t running;
 
-  void RunTask(F task) {
+  void RunTask() {
     std::unique_lock<std::mutex> UniqueLock(*this);
-    while(true) {
-       if (not Q::empty()) {
-          T item { std::move(Q::front()) };
-          Q::pop();
-          notify_one();
-          UniqueLock.unlock();
-          task(item);
-          UniqueLock.lock();
-          }
-       else
-         if (destroying) break;
-         else wait(UniqueLock);
+    while(not Q::empty()) {
+       T item { std::move(Q::front()) };
+       Q::pop();
+       notify_all();
+       UniqueLock.unlock();
+       task(item);
+       UniqueLock.lock();
+       }
+    running--;
+    notify_all();
+    }
+
+  /* needs the lock held. */
+  void Start() {
+    if (running < capacity and running < Q::size()) {
+       running++;
+       pool.Run([this]() { RunTask(); });
        }
     }
 
 public:
-  WorkQueue(F task, size_t Capacity = 0) : capacity(Capacity), destroying(false) {
+  WorkQueue(WorkerPool& Pool, F Task, size_t Capacity = 0) :
+    pool(Pool), task(Task), capacity(Capacity), running(0) {
     if (capacity == 0)
-       capacity = std::thread::hardware_concurrency();
-
-    for(size_t i = 0; i < capacity; i++)
-       Threads.emplace_back(static_cast<void (WorkQueue::*)(F)>(&WorkQueue::RunTask), this, task);
+       capacity = std::max(1U, std::thread::hardware_concurrency());
     }
-  WorkQueue(WorkQueue&&) = default;
+  WorkQueue(WorkQueue&&) = delete;
   WorkQueue& operator=(WorkQueue&&) = delete;
   ~WorkQueue() {
-      {
-        std::lock_guard<std::mutex> LockGuard(*this);
-        destroying = true;
-        notify_all();
-      }
-    for(auto&& t:Threads) t.join();
+    std::unique_lock<std::mutex> UniqueLock(*this);
+    while(running) wait(UniqueLock);
     }
   void Push(T&& value) {
     std::unique_lock<std::mutex> UniqueLock(*this);
     while(Q::size() == capacity) wait(UniqueLock);
     Q::push(std::forward<T>(value));
-    notify_one();
+    Start();
+    }
+  /* number of items waiting. */
+  size_t Size() {
+    std::lock_guard<std::mutex> LockGuard(*this);
+    return Q::size();
+    }
+  /* as Push(), but returns false instead of waiting, if the queue is full. */
+  bool TryPush(T&& value) {
+    std::unique_lock<std::mutex> UniqueLock(*this);
+    if (Q::size() == capacity) return false;
+    Q::push(std::forward<T>(value));
+    Start();
+    return true;
     }
 };